@@ -342,6 +342,9 @@ cdrom_audio_play(cdrom_t *dev, uint32_t pos, uint32_t len, int ismsf)
     dev->cd_status = CD_STATUS_PLAYING;
     dev->cd_buflen = 0;
 
+    if (dev->ops->audio_play)
+	dev->ops->audio_play(dev, pos, len);
+
     return 1;
 }
 
@@ -824,6 +827,18 @@ read_mode2_xa_form2(cdrom_t *dev, int cdrom_sector_flags, uint32_t lba, uint32_t
 }
 
 
+/* Fast path for plain 2048-byte Mode 1 reads of several sectors; returns
+   0 if the drive can't do it that way, and then nothing was read. */
+int
+cdrom_read_data_sectors(cdrom_t *dev, uint8_t *buffer, uint32_t lba, int num)
+{
+    if ((dev->cd_status == CD_STATUS_EMPTY) || !dev->ops || !dev->ops->read_sectors)
+	return 0;
+
+    return dev->ops->read_sectors(dev, buffer, lba, num);
+}
+
+
 int
 cdrom_readsector_raw(cdrom_t *dev, uint8_t *buffer, int sector, int ismsf, int cdrom_sector_type,
 		     int cdrom_sector_flags, int *len)
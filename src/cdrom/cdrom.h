@@ -85,7 +85,9 @@ typedef struct {
     void	(*get_subchannel)(struct cdrom *dev, uint32_t lba, subchannel_t *subc);
     int		(*sector_size)(struct cdrom *dev, uint32_t lba);
     int		(*read_sector)(struct cdrom *dev, int type, uint8_t *b, uint32_t lba);
+    int		(*read_sectors)(struct cdrom *dev, uint8_t *b, uint32_t lba, uint32_t num);
     int		(*track_type)(struct cdrom *dev, uint32_t lba);
+    void	(*audio_play)(struct cdrom *dev, uint32_t lba, uint32_t end);
     void	(*exit)(struct cdrom *dev);
 } cdrom_ops_t;
 
@@ -116,7 +118,8 @@ typedef struct cdrom {
 
     const cdrom_ops_t	*ops;
 
-    void	*image;
+    void	*image,
+		*audio;		/* CD-DA read-ahead, if any */
 
     void	(*insert)(void *p);
     void	(*close)(void *p);
@@ -140,6 +143,7 @@ extern int	cdrom_read_toc(cdrom_t *dev, unsigned char *b, int type,
 			       unsigned char start_track, int msf, int max_len);
 extern int	cdrom_readsector_raw(cdrom_t *dev, uint8_t *buffer, int sector, int ismsf,
 				     int cdrom_sector_type, int cdrom_sector_flags, int *len);
+extern int	cdrom_read_data_sectors(cdrom_t *dev, uint8_t *buffer, uint32_t lba, int num);
 extern void	cdrom_seek(cdrom_t *dev, uint32_t pos);
 
 extern void     cdrom_close_handler(uint8_t id);
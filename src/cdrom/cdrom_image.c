@@ -32,6 +32,7 @@
 #include "../config.h"
 #include "../plat.h"
 #include "../scsi/scsi_device.h"
+#include "../disk/disk_trace.h"
 #include "cdrom_image_backend.h"
 #include "cdrom.h"
 #include "cdrom_image.h"
@@ -172,21 +173,60 @@ static int
 image_read_sector(struct cdrom *dev, int type, uint8_t *b, uint32_t lba)
 {
     cd_img_t *img = (cd_img_t *)dev->image;
+    uint64_t start = disk_trace_start();
+    int ret;
 
+    if ((type == CD_READ_AUDIO) && dev->audio) {
+	ret = cdi_audio_read(dev->audio, b, lba);
+	disk_trace_end(DTRACE_CDROM, dev->id, DTRACE_READ, RAW_SECTOR_SIZE, start, !ret);
+	return ret;
+    }
+
+    cdi_audio_lock(dev->audio);
     switch (type) {
 	case CD_READ_DATA:
-		return cdi_read_sector(img, b, 0, lba);
+		ret = cdi_read_sector(img, b, 0, lba);
+		break;
 	case CD_READ_AUDIO:
-		return cdi_read_sector(img, b, 1, lba);
+		ret = cdi_read_sector(img, b, 1, lba);
+		break;
 	case CD_READ_RAW:
 		if (cdi_get_sector_size(img, lba) == 2352)
-			return cdi_read_sector(img, b, 1, lba);
+			ret = cdi_read_sector(img, b, 1, lba);
 		else
-			return cdi_read_sector_sub(img, b, lba);
+			ret = cdi_read_sector_sub(img, b, lba);
+		break;
 	default:
 		cdrom_image_log("CD-ROM %i: Unknown CD read type\n", dev->id);
-		return 0;
+		ret = 0;
+		break;
     }
+    cdi_audio_unlock(dev->audio);
+
+    disk_trace_end(DTRACE_CDROM, dev->id, DTRACE_READ,
+		   (type == CD_READ_DATA) ? COOKED_SECTOR_SIZE : RAW_SECTOR_SIZE, start, !ret);
+
+    return ret;
+}
+
+
+static int
+image_read_sectors(struct cdrom *dev, uint8_t *b, uint32_t lba, uint32_t num)
+{
+    cd_img_t *img = (cd_img_t *)dev->image;
+    uint64_t start = disk_trace_start();
+    int ret;
+
+    cdi_audio_lock(dev->audio);
+    ret = cdi_read_sectors(img, b, 0, lba, num);
+    cdi_audio_unlock(dev->audio);
+
+    /* On failure, the caller falls back to single sector reads, which
+       are counted on their own. */
+    if (ret)
+	disk_trace_end(DTRACE_CDROM, dev->id, DTRACE_READ, num * COOKED_SECTOR_SIZE, start, 0);
+
+    return ret;
 }
 
 
@@ -208,6 +248,14 @@ image_track_type(cdrom_t *dev, uint32_t lba)
 }
 
 
+static void
+image_audio_play(cdrom_t *dev, uint32_t lba, uint32_t end)
+{
+    if (dev->audio)
+	cdi_audio_play(dev->audio, lba, end);
+}
+
+
 static void
 image_exit(cdrom_t *dev)
 {
@@ -216,6 +264,11 @@ image_exit(cdrom_t *dev)
 cdrom_image_log("CDROM: image_exit(%ls)\n", dev->image_path);
     dev->cd_status = CD_STATUS_EMPTY;
 
+    if (dev->audio) {
+	cdi_audio_close(dev->audio);
+	dev->audio = NULL;
+    }
+
     if (img) {
 	cdi_close(img);
 	dev->image = NULL;
@@ -231,7 +284,9 @@ static const cdrom_ops_t cdrom_image_ops = {
     image_get_subchannel,
     image_sector_size,
     image_read_sector,
+    image_read_sectors,
     image_track_type,
+    image_audio_play,
     image_exit
 };
 
@@ -263,13 +318,15 @@ cdrom_image_open(cdrom_t *dev, const wchar_t *fn)
 
     memset(img, 0, sizeof(cd_img_t));
     dev->image = img;
+    dev->audio = NULL;
 
     /* Open the image. */
     if (!cdi_set_device(img, fn))
 	return image_open_abort(dev);
 
     /* All good, reset state. */
-    if (! wcscasecmp(plat_get_extension((wchar_t *) fn), L"ISO"))
+    if (! wcscasecmp(plat_get_extension((wchar_t *) fn), L"ISO") ||
+	! wcscasecmp(plat_get_extension((wchar_t *) fn), L"CDZ"))
 	dev->cd_status = CD_STATUS_DATA_ONLY;
     else
 	dev->cd_status = CD_STATUS_STOPPED;
@@ -278,6 +335,10 @@ cdrom_image_open(cdrom_t *dev, const wchar_t *fn)
     dev->cdrom_capacity = image_get_capacity(dev);
     cdrom_image_log("CD-ROM capacity: %i sectors (%i bytes)\n", dev->cdrom_capacity, dev->cdrom_capacity << 11);
 
+    /* Audio tracks get read ahead while playing. */
+    if ((dev->cd_status != CD_STATUS_DATA_ONLY) && cdi_has_audio_track(img))
+	dev->audio = cdi_audio_init(img);
+
     /* Attach this handler to the drive. */
     dev->ops = &cdrom_image_ops;
 
@@ -0,0 +1,284 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		CD-DA read-ahead for image-backed drives.
+ *
+ *		While an audio track plays, a reader thread keeps a ring of
+ *		raw sectors filled ahead of the play position, so the CD
+ *		audio thread only copies from memory instead of doing one
+ *		small file read per sector. A PLAY AUDIO or a read from any
+ *		other position restarts the ring there.
+ *
+ * Version:	@(#)cdrom_image_audio.c	1.0.0	2020/01/24
+ */
+#define _LARGEFILE_SOURCE
+#define _LARGEFILE64_SOURCE
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include "../86box.h"
+#include "../plat.h"
+#include "cdrom_image_backend.h"
+
+
+#define CDA_RING	256			/* sectors, about 3.4 seconds */
+#define CDA_CHUNK	16			/* sectors per file read */
+#define CDA_WAIT	100			/* ms to wait for a read in flight */
+
+
+typedef struct {
+    cd_img_t	*cdi;
+
+    mutex_t	*file_lock,		/* serializes access to the image */
+		*lock;			/* protects the ring state */
+    event_t	*wake, *ready;
+    thread_t	*thread;
+    volatile int quit;
+
+    uint32_t	gen,			/* bumped whenever the ring restarts */
+		lba,			/* sector at the read index */
+		fill,			/* next sector the thread reads */
+		end;			/* read ahead up to here */
+    int		rp, count;
+
+    uint8_t	*ring;
+    uint8_t	chunk[CDA_CHUNK * RAW_SECTOR_SIZE];
+} cdi_audio_t;
+
+
+uint32_t	cdrom_audio_hits, cdrom_audio_underruns,
+		cdrom_audio_misses;
+
+
+#ifdef ENABLE_CDROM_IMAGE_AUDIO_LOG
+int cdrom_image_audio_do_log = ENABLE_CDROM_IMAGE_AUDIO_LOG;
+
+
+static void
+cdrom_image_audio_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (cdrom_image_audio_do_log) {
+	va_start(ap, fmt);
+	pclog_ex(fmt, ap);
+	va_end(ap);
+    }
+}
+#else
+#define cdrom_image_audio_log(fmt, ...)
+#endif
+
+
+/* Move the ring to a new position, dropping whatever it holds. */
+static void
+cda_restart(cdi_audio_t *ra, uint32_t lba)
+{
+    ra->gen++;
+    ra->lba = ra->fill = lba;
+    ra->rp = ra->count = 0;
+}
+
+
+static void
+cda_thread(void *param)
+{
+    cdi_audio_t *ra = (cdi_audio_t *) param;
+    uint32_t gen, start;
+    int i, j, n, wp;
+
+    while (1) {
+	thread_wait_event(ra->wake, -1);
+	thread_reset_event(ra->wake);
+	if (ra->quit)
+		break;
+
+	while (! ra->quit) {
+		/* Claim the next run of sectors, if there is room. */
+		thread_wait_mutex(ra->lock);
+		n = CDA_RING - (int) (ra->fill - ra->lba);
+		if (n > CDA_CHUNK)
+			n = CDA_CHUNK;
+		if ((ra->fill + n) > ra->end)
+			n = (ra->end > ra->fill) ? (int) (ra->end - ra->fill) : 0;
+		gen = ra->gen;
+		start = ra->fill;
+		ra->fill += n;
+		thread_release_mutex(ra->lock);
+
+		if (n <= 0)
+			break;
+
+		/* Read it without holding the ring, so the audio thread
+		   can keep taking sectors meanwhile. */
+		thread_wait_mutex(ra->file_lock);
+		i = n;
+		if (! cdi_read_sectors(ra->cdi, ra->chunk, 1, start, n)) {
+			/* Find out how far it gets. */
+			for (i = 0; i < n; i++) {
+				if (! cdi_read_sector(ra->cdi, &ra->chunk[i * RAW_SECTOR_SIZE], 1, start + i))
+					break;
+			}
+		}
+		thread_release_mutex(ra->file_lock);
+
+		thread_wait_mutex(ra->lock);
+		if (ra->gen == gen) {
+			wp = (ra->rp + ra->count) % CDA_RING;
+			for (j = 0; j < i; j++) {
+				memcpy(&ra->ring[wp * RAW_SECTOR_SIZE],
+				       &ra->chunk[j * RAW_SECTOR_SIZE], RAW_SECTOR_SIZE);
+				wp = (wp + 1) % CDA_RING;
+			}
+			ra->count += i;
+
+			/* Stop at an unreadable sector; the audio thread
+			   reads it directly and gets the error. */
+			if (i < n) {
+				ra->fill = ra->end = start + i;
+				cdrom_image_audio_log("CD-DA: read-ahead stopped at %08X\n", start + i);
+			}
+		}
+		thread_release_mutex(ra->lock);
+
+		thread_set_event(ra->ready);
+	}
+    }
+}
+
+
+void *
+cdi_audio_init(cd_img_t *cdi)
+{
+    cdi_audio_t *ra;
+
+    ra = (cdi_audio_t *) malloc(sizeof(cdi_audio_t));
+    if (ra == NULL)
+	return(NULL);
+    memset(ra, 0x00, sizeof(cdi_audio_t));
+
+    ra->ring = (uint8_t *) malloc(CDA_RING * RAW_SECTOR_SIZE);
+    if (ra->ring == NULL) {
+	free(ra);
+	return(NULL);
+    }
+
+    ra->cdi = cdi;
+    ra->file_lock = thread_create_mutex(NULL);
+    ra->lock = thread_create_mutex(NULL);
+    ra->wake = thread_create_event();
+    ra->ready = thread_create_event();
+    ra->thread = thread_create(cda_thread, ra);
+
+    return(ra);
+}
+
+
+void
+cdi_audio_close(void *p)
+{
+    cdi_audio_t *ra = (cdi_audio_t *) p;
+
+    if (ra == NULL)
+	return;
+
+    ra->quit = 1;
+    thread_set_event(ra->wake);
+    thread_wait(ra->thread, -1);
+
+    thread_destroy_event(ra->ready);
+    thread_destroy_event(ra->wake);
+    thread_close_mutex(ra->lock);
+    thread_close_mutex(ra->file_lock);
+
+    free(ra->ring);
+    free(ra);
+}
+
+
+/* Start reading ahead from a new play position, up to (not including) end. */
+void
+cdi_audio_play(void *p, uint32_t lba, uint32_t end)
+{
+    cdi_audio_t *ra = (cdi_audio_t *) p;
+
+    thread_wait_mutex(ra->lock);
+    cda_restart(ra, lba);
+    ra->end = end;
+    thread_release_mutex(ra->lock);
+
+    thread_set_event(ra->wake);
+}
+
+
+int
+cdi_audio_read(void *p, uint8_t *buffer, uint32_t lba)
+{
+    cdi_audio_t *ra = (cdi_audio_t *) p;
+    int ret, waited = 0;
+
+    thread_wait_mutex(ra->lock);
+    while ((lba == ra->lba) && !ra->count && (ra->fill > lba) && (waited < 2)) {
+	/* The thread is reading this very sector, wait for it. */
+	thread_reset_event(ra->ready);
+	thread_release_mutex(ra->lock);
+	if (! waited++)
+		cdrom_audio_underruns++;
+	thread_wait_event(ra->ready, CDA_WAIT);
+	thread_wait_mutex(ra->lock);
+    }
+
+    if ((lba == ra->lba) && ra->count) {
+	memcpy(buffer, &ra->ring[ra->rp * RAW_SECTOR_SIZE], RAW_SECTOR_SIZE);
+	ra->rp = (ra->rp + 1) % CDA_RING;
+	ra->count--;
+	ra->lba++;
+	thread_release_mutex(ra->lock);
+
+	cdrom_audio_hits++;
+	thread_set_event(ra->wake);
+	return(1);
+    }
+
+    /* Not in the ring: read it here and carry on from the next one. */
+    if (lba != ra->lba)
+	cdrom_audio_misses++;
+    cda_restart(ra, lba + 1);
+    if (ra->end <= ra->fill)
+	ra->end = ra->fill + CDA_RING;
+    thread_release_mutex(ra->lock);
+
+    thread_wait_mutex(ra->file_lock);
+    ret = cdi_read_sector(ra->cdi, buffer, 1, lba);
+    thread_release_mutex(ra->file_lock);
+
+    thread_set_event(ra->wake);
+    return(ret);
+}
+
+
+/* Any other access to the image must go through these, since the
+   reader thread shares its file handles. */
+void
+cdi_audio_lock(void *p)
+{
+    if (p != NULL)
+	thread_wait_mutex(((cdi_audio_t *) p)->file_lock);
+}
+
+
+void
+cdi_audio_unlock(void *p)
+{
+    if (p != NULL)
+	thread_release_mutex(((cdi_audio_t *) p)->file_lock);
+}
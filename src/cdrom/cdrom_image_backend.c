@@ -37,6 +37,7 @@
 #define HAVE_STDARG_H
 #include "../86box.h"
 #include "../plat.h"
+#include "../disk/disk_shm.h"
 #include "cdrom_image_backend.h"
 
 
@@ -79,6 +80,9 @@ bin_read(void *p, uint8_t *buffer, uint64_t seek, size_t count)
     if (tf->file == NULL)
 	return 0;
 
+    if (tf->shm != NULL)
+	return (disk_shm_read(tf->shm, tf->file, buffer, seek, count) == count);
+
     fseeko64(tf->file, seek, SEEK_SET);
 
     if (fread(buffer, count, 1, tf->file) != 1) {
@@ -124,6 +128,11 @@ bin_close(void *p)
 	tf->file = NULL;
     }
 
+    if (tf->shm != NULL) {
+	disk_shm_close(tf->shm);
+	tf->shm = NULL;
+    }
+
     memset(tf->fn, 0x00, sizeof(tf->fn));
 
     free(p);
@@ -141,9 +150,13 @@ bin_init(const wchar_t *filename, int *error)
     cdrom_image_backend_log("CDROM: binary_open(%ls) = %08lx\n", tf->fn, tf->file);
 
     *error = (tf->file == NULL);
+    tf->shm = NULL;
 
     /* Set the function pointers. */
     if (!*error) {
+	/* Image files are never written, so they can always be shared. */
+	tf->shm = disk_shm_open(tf->fn);
+
 	tf->read = bin_read;
 	tf->get_length = bin_get_length;
 	tf->close = bin_close;
@@ -156,8 +169,11 @@ bin_init(const wchar_t *filename, int *error)
 static track_file_t *
 track_file_init(const wchar_t *filename, int *error)
 {
-    /* Current we only support .BIN files, either combined or one per
-       track. In the future, more is planned. */
+    /* Either .BIN files, combined or one per track, or compressed
+       .CDZ files made from them. */
+    if (cdz_probe(filename))
+	return cdz_init(filename, error);
+
     return bin_init(filename, error);
 }
 
@@ -199,6 +215,7 @@ cdi_clear_tracks(cd_img_t *cdi)
     /* Now free the array. */
     free(cdi->tracks);
     cdi->tracks = NULL;
+    cdi->last_track = 0;
 
     /* Mark that there's no tracks. */
     cdi->tracks_num = 0;
@@ -209,6 +226,8 @@ void
 cdi_close(cd_img_t *cdi)
 {
     cdi_clear_tracks(cdi);
+    if (cdi->buf != NULL)
+	free(cdi->buf);
     free(cdi);
 }
 
@@ -258,29 +277,66 @@ cdi_get_audio_track_info(cd_img_t *cdi, int end, int track, int *track_num, TMSF
 }
 
 
-int
-cdi_get_track(cd_img_t *cdi, uint32_t sector)
+/* Returns the index of the track holding the sector, or -1. */
+static int
+cdi_find_track(cd_img_t *cdi, uint32_t sector)
 {
-    int i;
+    int i, lo, hi;
     track_t *cur, *next;
 
     /* There must be at least two tracks - data and lead out. */
     if (cdi->tracks_num < 2)
 	return -1;
 
+    /* Sequential reads nearly always stay on the last track found. */
+    i = cdi->last_track;
+    if ((i < (cdi->tracks_num - 1)) && (cdi->tracks[i].start <= sector) &&
+	(sector < cdi->tracks[i + 1].start))
+	return i;
+
+    /* Track starts only ever go up, so look for the last track that
+       starts at or before the sector, leaving out the lead out. */
+    lo = 0;
+    hi = cdi->tracks_num - 2;
+    while (lo < hi) {
+	i = (lo + hi + 1) >> 1;
+	if (cdi->tracks[i].start <= sector)
+		lo = i;
+	else
+		hi = i - 1;
+    }
+    cur = &cdi->tracks[lo];
+    next = &cdi->tracks[lo + 1];
+    if ((cur->start <= sector) && (sector < next->start)) {
+	cdi->last_track = lo;
+	return lo;
+    }
+
     /* This has a problem - the code skips the last track, which is
        lead out - is that correct? */
     for (i = 0; i < (cdi->tracks_num - 1); i++) {
 	cur = &cdi->tracks[i];
 	next = &cdi->tracks[i + 1];
 	if ((cur->start <= sector) && (sector < next->start))
-		return cur->number;
+		return i;
     }
 
     return -1;
 }
 
 
+int
+cdi_get_track(cd_img_t *cdi, uint32_t sector)
+{
+    int i = cdi_find_track(cdi, sector);
+
+    if (i < 0)
+	return -1;
+
+    return cdi->tracks[i].number;
+}
+
+
 /* TODO: See if track start is adjusted by 150 or not. */
 int
 cdi_get_audio_sub(cd_img_t *cdi, uint32_t sector, uint8_t *attr, uint8_t *track, uint8_t *index, TMSF *rel_pos, TMSF *abs_pos)
@@ -368,30 +424,82 @@ cdi_read_sector(cd_img_t *cdi, uint8_t *buffer, int raw, uint32_t sector)
 }
 
 
+/* Scratch buffer for reads that need reshaping, kept with the image. */
+static uint8_t *
+cdi_get_buffer(cd_img_t *cdi, size_t len)
+{
+    uint8_t *buf;
+
+    if (len > cdi->buf_len) {
+	buf = (uint8_t *) realloc(cdi->buf, len);
+	if (buf == NULL)
+		return NULL;
+	cdi->buf = buf;
+	cdi->buf_len = len;
+    }
+
+    return cdi->buf;
+}
+
+
+/* Reads a run of sectors, either raw (2352 bytes each, from raw tracks
+   only, like cdi_read_sector) or cooked Mode 1 user data (2048 bytes
+   each, from any data track that is not Mode 2). The track is looked up
+   once per run of sectors on it and each run is a single file read.
+   Returns 0 without a partial result if any sector can't be read this
+   way, so the caller can fall back to cdi_read_sector. */
 int
 cdi_read_sectors(cd_img_t *cdi, uint8_t *buffer, int raw, uint32_t sector, uint32_t num)
 {
-    int sector_size, success = 1;
-    uint8_t buf_len, *buf;
-    uint32_t i;
+    int track, offset, out_size, track_is_raw;
+    uint32_t i, run;
+    uint64_t seek;
+    uint8_t *buf;
+    track_t *trk;
 
-    /* TODO: This fails to account for Mode 2. Shouldn't we have a function 
-	     to get sector size? */
-    sector_size = raw ? RAW_SECTOR_SIZE : COOKED_SECTOR_SIZE;
-    buf_len = num * sector_size;
-    buf = (uint8_t *) malloc(buf_len * sizeof(uint8_t));
+    out_size = raw ? RAW_SECTOR_SIZE : COOKED_SECTOR_SIZE;
 
-    for (i = 0; i < num; i++) {
-	success = cdi_read_sector(cdi, &buf[i * sector_size], raw, sector + i);
-	if (!success)
-		break;
-    }
+    while (num > 0) {
+	track = cdi_find_track(cdi, sector);
+	if (track < 0)
+		return 0;
 
-    memcpy((void *) buffer, buf, buf_len);
-    free(buf);
-    buf = NULL;
+	trk = &cdi->tracks[track];
+	track_is_raw = ((trk->sector_size == RAW_SECTOR_SIZE) || (trk->sector_size == 2448));
+	if (raw && !track_is_raw)
+		return 0;
+	if (!raw && (trk->mode2 || (trk->attr == AUDIO_TRACK)))
+		return 0;
+	if (!raw && !track_is_raw && (trk->sector_size != COOKED_SECTOR_SIZE))
+		return 0;
 
-    return success;
+	run = (uint32_t) (cdi->tracks[track + 1].start - sector);
+	if (run > num)
+		run = num;
+	seek = trk->skip + (((uint64_t) sector - trk->start) * trk->sector_size);
+
+	if (trk->sector_size == out_size) {
+		/* Same layout as requested, straight into the buffer. */
+		if (!trk->file->read(trk->file, buffer, seek, run * out_size))
+			return 0;
+	} else {
+		/* Raw sectors to cook, or ones with subchannel data to drop. */
+		buf = cdi_get_buffer(cdi, run * trk->sector_size);
+		if (buf == NULL)
+			return 0;
+		if (!trk->file->read(trk->file, buf, seek, run * trk->sector_size))
+			return 0;
+		offset = raw ? 0 : 16;
+		for (i = 0; i < run; i++)
+			memcpy(buffer + (i * out_size), buf + (i * trk->sector_size) + offset, out_size);
+	}
+
+	buffer += run * out_size;
+	sector += run;
+	num -= run;
+    }
+
+    return 1;
 }
 
 
@@ -506,7 +614,7 @@ cdi_load_iso(cd_img_t *cdi, const wchar_t *filename)
     memset(&trk, 0, sizeof(track_t));
 
     /* Data track (shouldn't there be a lead in track?). */
-    trk.file = bin_init(filename, &error);
+    trk.file = track_file_init(filename, &error);
     if (error) {
 	if (trk.file != NULL)
 		trk.file->close(trk.file);
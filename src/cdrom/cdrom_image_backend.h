@@ -54,6 +54,7 @@ typedef struct {
 
     wchar_t		fn[260];
     FILE		*file;
+    void		*shm;		/* shared block cache, if any */
 } track_file_t;
 
 typedef struct {
@@ -67,6 +68,10 @@ typedef struct {
 typedef struct {
     int			tracks_num;
     track_t		*tracks;
+
+    int			last_track;	/* cdi_get_track() hint */
+    uint8_t		*buf;		/* scratch for multi-sector reads */
+    size_t		buf_len;
 } cd_img_t;
 
 
@@ -88,6 +93,22 @@ extern int	cdi_load_cue(cd_img_t *cdi, const wchar_t *cuefile);
 extern int	cdi_has_data_track(cd_img_t *cdi);
 extern int	cdi_has_audio_track(cd_img_t *cdi);
 
+/* Compressed image files. */
+extern int	cdz_probe(const wchar_t *filename);
+extern track_file_t *cdz_init(const wchar_t *filename, int *error);
+extern int	cdz_convert(const wchar_t *in, const wchar_t *out);
+
+/* CD-DA read-ahead. */
+extern uint32_t	cdrom_audio_hits, cdrom_audio_underruns,
+		cdrom_audio_misses;
+
+extern void	*cdi_audio_init(cd_img_t *cdi);
+extern void	cdi_audio_close(void *p);
+extern void	cdi_audio_play(void *p, uint32_t lba, uint32_t end);
+extern int	cdi_audio_read(void *p, uint8_t *buffer, uint32_t lba);
+extern void	cdi_audio_lock(void *p);
+extern void	cdi_audio_unlock(void *p);
+
 
 
 #endif /* ! CDROM_IMAGE_BACKEND_H */
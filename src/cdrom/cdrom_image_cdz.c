@@ -0,0 +1,465 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		Compressed CD-ROM image files (.CDZ).
+ *
+ *		A .CDZ file holds one .ISO or .BIN file cut into fixed size
+ *		hunks, each compressed on its own with LZF (or stored as is
+ *		if that doesn't help), plus an index of where every hunk is.
+ *		It can be opened directly like an .ISO, or named in a cue
+ *		sheet in place of the .BIN it was made from.
+ *
+ *		Decompressed hunks go into a small LRU cache shared by all
+ *		open images, so sequential reads decompress each hunk once.
+ *
+ *		File layout (little endian):
+ *
+ *		  header	cdz_header_t
+ *		  index		cdz_entry_t[hunks]
+ *		  data		compressed hunks
+ *
+ * Version:	@(#)cdrom_image_cdz.c	1.0.0	2020/01/26
+ */
+#define _LARGEFILE_SOURCE
+#define _LARGEFILE64_SOURCE
+#define __STDC_FORMAT_MACROS
+#include <stdarg.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include "../86box.h"
+#include "../plat.h"
+#include "../floppy/lzf/lzf.h"
+#include "cdrom_image_backend.h"
+
+
+#define CDZ_MAGIC	"86BoxCDZ"
+#define CDZ_VERSION	1
+
+#define CDZ_STORED	0x0001			/* hunk is not compressed */
+
+#define CDZ_CACHE	64			/* hunks in the shared cache */
+
+
+#pragma pack(push,1)
+typedef struct {
+    char	magic[8];
+    uint32_t	version,
+		hunk_size;
+    uint64_t	length;				/* of the original file */
+    uint32_t	hunks,
+		flags;
+} cdz_header_t;
+
+typedef struct {
+    uint64_t	offset;
+    uint32_t	size,
+		flags;
+} cdz_entry_t;
+#pragma pack(pop)
+
+typedef struct {
+    track_file_t tf;				/* must be first */
+
+    uint32_t	id,
+		hunk_size,
+		hunks;
+    uint64_t	length;
+    cdz_entry_t	*index;
+
+    uint8_t	*cbuf,				/* compressed hunk */
+		*hbuf;				/* decompressed hunk */
+} cdz_t;
+
+typedef struct {
+    uint32_t	id, hunk,
+		used,
+		size;
+    uint8_t	*data;
+} cdz_hunk_t;
+
+
+static cdz_hunk_t	cdz_cache[CDZ_CACHE];
+static mutex_t		*cdz_lock = NULL;
+static uint32_t		cdz_tick,
+			cdz_next_id = 1;
+
+
+#ifdef ENABLE_CDROM_IMAGE_CDZ_LOG
+int cdrom_image_cdz_do_log = ENABLE_CDROM_IMAGE_CDZ_LOG;
+
+
+static void
+cdz_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (cdrom_image_cdz_do_log) {
+	va_start(ap, fmt);
+	pclog_ex(fmt, ap);
+	va_end(ap);
+    }
+}
+#else
+#define cdz_log(fmt, ...)
+#endif
+
+
+/* Look a hunk up in the cache, with cdz_lock held. */
+static cdz_hunk_t *
+cdz_cache_find(cdz_t *cdz, uint32_t hunk)
+{
+    int i;
+
+    for (i = 0; i < CDZ_CACHE; i++) {
+	if ((cdz_cache[i].id == cdz->id) && (cdz_cache[i].hunk == hunk) &&
+	    (cdz_cache[i].data != NULL)) {
+		cdz_cache[i].used = ++cdz_tick;
+		return(&cdz_cache[i]);
+	}
+    }
+
+    return(NULL);
+}
+
+
+/* Put a freshly decompressed hunk in the least recently used slot. */
+static cdz_hunk_t *
+cdz_cache_insert(cdz_t *cdz, uint32_t hunk)
+{
+    cdz_hunk_t *h = &cdz_cache[0];
+    uint8_t *data;
+    int i;
+
+    for (i = 1; i < CDZ_CACHE; i++) {
+	if (cdz_cache[i].used < h->used)
+		h = &cdz_cache[i];
+    }
+
+    if ((h->data == NULL) || (h->size < cdz->hunk_size)) {
+	data = (uint8_t *) realloc(h->data, cdz->hunk_size);
+	if (data == NULL)
+		return(NULL);
+	h->data = data;
+	h->size = cdz->hunk_size;
+    }
+
+    memcpy(h->data, cdz->hbuf, cdz->hunk_size);
+    h->id = cdz->id;
+    h->hunk = hunk;
+    h->used = ++cdz_tick;
+
+    return(h);
+}
+
+
+/* Read and decompress one hunk into hbuf. */
+static int
+cdz_load_hunk(cdz_t *cdz, uint32_t hunk)
+{
+    cdz_entry_t *e = &cdz->index[hunk];
+
+    /* Every hunk, the padded last one included, is hunk_size long. */
+    if ((e->size > cdz->hunk_size) || ((e->flags & CDZ_STORED) && (e->size != cdz->hunk_size)))
+	return(0);
+
+    fseeko64(cdz->tf.file, e->offset, SEEK_SET);
+    if (e->flags & CDZ_STORED) {
+	if (fread(cdz->hbuf, 1, e->size, cdz->tf.file) != e->size)
+		return(0);
+    } else {
+	if (fread(cdz->cbuf, 1, e->size, cdz->tf.file) != e->size)
+		return(0);
+	if (lzf_decompress(cdz->cbuf, e->size, cdz->hbuf, cdz->hunk_size) != cdz->hunk_size) {
+		cdz_log("CDZ: hunk %u of %ls is corrupt\n", hunk, cdz->tf.fn);
+		return(0);
+	}
+    }
+
+    return(1);
+}
+
+
+static int
+cdz_read(void *p, uint8_t *buffer, uint64_t seek, size_t count)
+{
+    cdz_t *cdz = (cdz_t *) p;
+    cdz_hunk_t *h;
+    uint32_t hunk, off, n;
+
+    if ((cdz->tf.file == NULL) || ((seek + count) > cdz->length))
+	return(0);
+
+    while (count > 0) {
+	hunk = (uint32_t) (seek / cdz->hunk_size);
+	off = (uint32_t) (seek % cdz->hunk_size);
+	n = cdz->hunk_size - off;
+	if (n > count)
+		n = (uint32_t) count;
+
+	thread_wait_mutex(cdz_lock);
+	h = cdz_cache_find(cdz, hunk);
+	if (h != NULL)
+		memcpy(buffer, h->data + off, n);
+	thread_release_mutex(cdz_lock);
+
+	if (h == NULL) {
+		/* Decompress outside the lock, so other drives can keep
+		   reading cached hunks meanwhile. */
+		if (! cdz_load_hunk(cdz, hunk))
+			return(0);
+		memcpy(buffer, cdz->hbuf + off, n);
+
+		thread_wait_mutex(cdz_lock);
+		cdz_cache_insert(cdz, hunk);
+		thread_release_mutex(cdz_lock);
+	}
+
+	buffer += n;
+	seek += n;
+	count -= n;
+    }
+
+    return(1);
+}
+
+
+static uint64_t
+cdz_get_length(void *p)
+{
+    cdz_t *cdz = (cdz_t *) p;
+
+    return(cdz->length);
+}
+
+
+static void
+cdz_close(void *p)
+{
+    cdz_t *cdz = (cdz_t *) p;
+    int i;
+
+    if (cdz == NULL)
+	return;
+
+    /* Drop its hunks from the cache. */
+    thread_wait_mutex(cdz_lock);
+    for (i = 0; i < CDZ_CACHE; i++) {
+	if (cdz_cache[i].id == cdz->id)
+		cdz_cache[i].id = cdz_cache[i].used = 0;
+    }
+    thread_release_mutex(cdz_lock);
+
+    if (cdz->tf.file != NULL)
+	fclose(cdz->tf.file);
+    if (cdz->index != NULL)
+	free(cdz->index);
+    if (cdz->cbuf != NULL)
+	free(cdz->cbuf);
+    if (cdz->hbuf != NULL)
+	free(cdz->hbuf);
+
+    free(cdz);
+}
+
+
+int
+cdz_probe(const wchar_t *filename)
+{
+    char magic[8];
+    FILE *f;
+    int ret = 0;
+
+    f = plat_fopen64(filename, L"rb");
+    if (f == NULL)
+	return(0);
+
+    if (fread(magic, 1, sizeof(magic), f) == sizeof(magic))
+	ret = !memcmp(magic, CDZ_MAGIC, sizeof(magic));
+    fclose(f);
+
+    return(ret);
+}
+
+
+track_file_t *
+cdz_init(const wchar_t *filename, int *error)
+{
+    cdz_header_t hdr;
+    cdz_t *cdz;
+
+    *error = 1;
+
+    if (cdz_lock == NULL)
+	cdz_lock = thread_create_mutex(NULL);
+
+    cdz = (cdz_t *) malloc(sizeof(cdz_t));
+    if (cdz == NULL)
+	return(NULL);
+    memset(cdz, 0x00, sizeof(cdz_t));
+
+    wcscpy(cdz->tf.fn, filename);
+    cdz->tf.file = plat_fopen64(cdz->tf.fn, L"rb");
+    if (cdz->tf.file == NULL) {
+	free(cdz);
+	return(NULL);
+    }
+
+    if ((fread(&hdr, 1, sizeof(hdr), cdz->tf.file) != sizeof(hdr)) ||
+	memcmp(hdr.magic, CDZ_MAGIC, sizeof(hdr.magic)) ||
+	(hdr.version != CDZ_VERSION) || (hdr.hunk_size == 0) ||
+	(hdr.hunks != ((hdr.length + hdr.hunk_size - 1) / hdr.hunk_size))) {
+	cdz_log("CDZ: %ls is not a valid image\n", filename);
+	cdz_close(cdz);
+	return(NULL);
+    }
+
+    cdz->hunk_size = hdr.hunk_size;
+    cdz->hunks = hdr.hunks;
+    cdz->length = hdr.length;
+    cdz->index = (cdz_entry_t *) malloc(hdr.hunks * sizeof(cdz_entry_t));
+    cdz->cbuf = (uint8_t *) malloc(hdr.hunk_size);
+    cdz->hbuf = (uint8_t *) malloc(hdr.hunk_size);
+    if ((cdz->index == NULL) || (cdz->cbuf == NULL) || (cdz->hbuf == NULL) ||
+	(fread(cdz->index, sizeof(cdz_entry_t), hdr.hunks, cdz->tf.file) != hdr.hunks)) {
+	cdz_close(cdz);
+	return(NULL);
+    }
+
+    cdz->id = cdz_next_id++;
+
+    cdz->tf.read = cdz_read;
+    cdz->tf.get_length = cdz_get_length;
+    cdz->tf.close = cdz_close;
+
+    cdz_log("CDZ: opened %ls, %u hunks of %u bytes\n", filename, cdz->hunks, cdz->hunk_size);
+
+    *error = 0;
+    return(&cdz->tf);
+}
+
+
+/* Compress an .ISO or .BIN file into a .CDZ file. Returns 0 on success;
+   on failure, no output file is left behind. */
+int
+cdz_convert(const wchar_t *in, const wchar_t *out)
+{
+    cdz_header_t hdr;
+    cdz_entry_t *index = NULL;
+    uint8_t *ibuf = NULL, *obuf = NULL;
+    FILE *fi = NULL, *fo = NULL;
+    uint64_t offset;
+    uint32_t i, len, clen;
+    int ret = 1;
+
+    fi = plat_fopen64(in, L"rb");
+    if (fi == NULL) {
+	printf("Unable to open '%ls'\n", in);
+	return(1);
+    }
+    fo = plat_fopen64(out, L"wb");
+    if (fo == NULL) {
+	printf("Unable to create '%ls'\n", out);
+	fclose(fi);
+	return(1);
+    }
+
+    memset(&hdr, 0x00, sizeof(hdr));
+    memcpy(hdr.magic, CDZ_MAGIC, sizeof(hdr.magic));
+    hdr.version = CDZ_VERSION;
+    fseeko64(fi, 0, SEEK_END);
+    hdr.length = ftello64(fi);
+    fseeko64(fi, 0, SEEK_SET);
+
+    /* Whole sectors per hunk, so most sector reads touch one hunk. */
+    if ((hdr.length % RAW_SECTOR_SIZE) == 0)
+	hdr.hunk_size = 16 * RAW_SECTOR_SIZE;
+    else
+	hdr.hunk_size = 32 * COOKED_SECTOR_SIZE;
+    hdr.hunks = (uint32_t) ((hdr.length + hdr.hunk_size - 1) / hdr.hunk_size);
+
+    index = (cdz_entry_t *) malloc((hdr.hunks ? hdr.hunks : 1) * sizeof(cdz_entry_t));
+    ibuf = (uint8_t *) malloc(hdr.hunk_size);
+    obuf = (uint8_t *) malloc(hdr.hunk_size);
+    if ((index == NULL) || (ibuf == NULL) || (obuf == NULL))
+	goto done;
+
+    /* Header and a placeholder index, which gets filled in at the end. */
+    memset(index, 0x00, hdr.hunks * sizeof(cdz_entry_t));
+    if ((fwrite(&hdr, 1, sizeof(hdr), fo) != sizeof(hdr)) ||
+	(fwrite(index, sizeof(cdz_entry_t), hdr.hunks, fo) != hdr.hunks)) {
+	printf("Write error in '%ls'\n", out);
+	goto done;
+    }
+    offset = sizeof(hdr) + (hdr.hunks * sizeof(cdz_entry_t));
+
+    for (i = 0; i < hdr.hunks; i++) {
+	len = hdr.hunk_size;
+	if (((uint64_t) (i + 1) * hdr.hunk_size) > hdr.length)
+		len = (uint32_t) (hdr.length - ((uint64_t) i * hdr.hunk_size));
+
+	/* The last hunk is padded, so every hunk decompresses to a
+	   full hunk_size. */
+	memset(ibuf, 0x00, hdr.hunk_size);
+	if (fread(ibuf, 1, len, fi) != len) {
+		printf("Read error in '%ls'\n", in);
+		goto done;
+	}
+
+	clen = lzf_compress(ibuf, hdr.hunk_size, obuf, hdr.hunk_size - 1);
+	index[i].offset = offset;
+	if (clen == 0) {
+		index[i].size = hdr.hunk_size;
+		index[i].flags = CDZ_STORED;
+	} else {
+		index[i].size = clen;
+		index[i].flags = 0;
+	}
+	if (fwrite((clen == 0) ? ibuf : obuf, 1, index[i].size, fo) != index[i].size) {
+		printf("Write error in '%ls'\n", out);
+		goto done;
+	}
+	offset += index[i].size;
+    }
+
+    fseeko64(fo, sizeof(hdr), SEEK_SET);
+    if (fwrite(index, sizeof(cdz_entry_t), hdr.hunks, fo) != hdr.hunks) {
+	printf("Write error in '%ls'\n", out);
+	goto done;
+    }
+
+    ret = 0;
+
+done:
+    if (index != NULL)
+	free(index);
+    if (ibuf != NULL)
+	free(ibuf);
+    if (obuf != NULL)
+	free(obuf);
+    fclose(fi);
+
+    /* Data still buffered may not make it out either. */
+    if ((fclose(fo) != 0) && (ret == 0)) {
+	printf("Write error in '%ls'\n", out);
+	ret = 1;
+    }
+
+    if (ret == 0)
+	printf("%ls: %" PRIu64 " bytes in %u hunks, compressed to %" PRIu64 " bytes (%i%%)\n",
+	       out, hdr.length, hdr.hunks, offset,
+	       hdr.length ? (int) ((offset * 100) / hdr.length) : 100);
+    else
+	plat_remove((wchar_t *) out);
+
+    return(ret);
+}
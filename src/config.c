@@ -45,10 +45,12 @@
 #include "disk/hdd.h"
 #include "disk/hdc.h"
 #include "disk/hdc_ide.h"
+#include "disk/disk_shm.h"
 #include "floppy/fdd.h"
 #include "floppy/fdc.h"
 #include "game/gameport.h"
 #include "machine/machine.h"
+#include "mem.h"
 #include "mouse.h"
 #include "network/network.h"
 #include "scsi/scsi.h"
@@ -65,6 +67,10 @@
 #include "ui.h"
 
 
+#ifdef USE_NEW_DYNAREC
+extern int	codegen_cache_size;
+#endif
+
 typedef struct _list_ {
     struct _list_ *next;
 } list_t;
@@ -537,6 +543,13 @@ load_machine(void)
 
     cpu_use_dynarec = !!config_get_int(cat, "cpu_use_dynarec", 0);
 
+    cachesize = config_get_int(cat, "mem_lookup_size", 256);
+    cacheways = config_get_int(cat, "mem_lookup_ways", 0);
+
+#ifdef USE_NEW_DYNAREC
+    codegen_cache_size = config_get_int(cat, "dynarec_cache_size", 0);
+#endif
+
     enable_external_fpu = !!config_get_int(cat, "cpu_enable_fpu", 0);
 
     p = config_get_string(cat, "time_sync", NULL);
@@ -662,6 +675,26 @@ load_sound(void)
 	sound_is_float = 1;
       else
 	sound_is_float = 0;
+
+    sound_worker_enable = !!config_get_int(cat, "sound_workers", 0);
+
+    p = config_get_string(cat, "sound_output", NULL);
+    if (p != NULL)
+	sound_backend_current = sound_backend_get_from_internal_name(p);
+      else
+	sound_backend_current = 0;
+
+    sound_queue_depth = config_get_int(cat, "sound_queue", 4);
+    if (sound_queue_depth < 2)
+	sound_queue_depth = 2;
+    if (sound_queue_depth > SOUND_QUEUE_MAX)
+	sound_queue_depth = SOUND_QUEUE_MAX;
+
+    sound_block_mult = config_get_int(cat, "sound_block", 1);
+    if (sound_block_mult < 1)
+	sound_block_mult = 1;
+    if (sound_block_mult > SOUND_BLOCK_MAX)
+	sound_block_mult = SOUND_BLOCK_MAX;
 }
 
 
@@ -786,6 +819,9 @@ load_other_peripherals(void)
 
     bugger_enabled = !!config_get_int(cat, "bugger_enabled", 0);
 
+    /* MB of shared block cache per read-only image, 0 to disable. */
+    disk_shm_size = config_get_int(cat, "shared_image_cache", 0);
+
     for (c = 0; c < ISAMEM_MAX; c++) {
 	sprintf(temp, "isamem%d_type", c);
 
@@ -811,6 +847,9 @@ load_hard_disks(void)
     uint32_t max_spt, max_hpc, max_tracks;
     uint32_t board = 0, dev = 0;
 
+    /* 0 = write-through, 1 = write-back, 2 = unsafe. */
+    hdd_cache_mode = config_get_int(cat, "write_cache", HDD_CACHE_WRITETHROUGH);
+
     memset(temp, '\0', sizeof(temp));
     for (c=0; c<HDD_NUM; c++) {
 	sprintf(temp, "hdd_%02i_parameters", c+1);
@@ -1421,6 +1460,23 @@ save_machine(void)
 
     config_set_int(cat, "cpu_use_dynarec", cpu_use_dynarec);
 
+    if (cachesize == 256)
+	config_delete_var(cat, "mem_lookup_size");
+      else
+	config_set_int(cat, "mem_lookup_size", cachesize);
+
+    if (cacheways == 0)
+	config_delete_var(cat, "mem_lookup_ways");
+      else
+	config_set_int(cat, "mem_lookup_ways", cacheways);
+
+#ifdef USE_NEW_DYNAREC
+    if (codegen_cache_size == 0)
+	config_delete_var(cat, "dynarec_cache_size");
+      else
+	config_set_int(cat, "dynarec_cache_size", codegen_cache_size);
+#endif
+
     if (enable_external_fpu == 0)
 	config_delete_var(cat, "cpu_enable_fpu");
       else
@@ -1556,6 +1612,26 @@ save_sound(void)
       else
 	config_set_string(cat, "sound_type", (sound_is_float == 1) ? "float" : "int16");
 
+    if (sound_worker_enable == 0)
+	config_delete_var(cat, "sound_workers");
+      else
+	config_set_int(cat, "sound_workers", sound_worker_enable);
+
+    if (sound_backend_current == 0)
+	config_delete_var(cat, "sound_output");
+      else
+	config_set_string(cat, "sound_output", sound_backend_get_internal_name(sound_backend_current));
+
+    if (sound_queue_depth == 4)
+	config_delete_var(cat, "sound_queue");
+      else
+	config_set_int(cat, "sound_queue", sound_queue_depth);
+
+    if (sound_block_mult == 1)
+	config_delete_var(cat, "sound_block");
+      else
+	config_set_int(cat, "sound_block", sound_block_mult);
+
     delete_section_if_empty(cat);
 }
 
@@ -1660,6 +1736,11 @@ save_other_peripherals(void)
       else
 	config_set_int(cat, "bugger_enabled", bugger_enabled);
 
+    if (disk_shm_size == 0)
+	config_delete_var(cat, "shared_image_cache");
+      else
+	config_set_int(cat, "shared_image_cache", disk_shm_size);
+
     for (c = 0; c < ISAMEM_MAX; c++) {
 	sprintf(temp, "isamem%d_type", c);
 	if (isamem_type[c] == 0)
@@ -1688,6 +1769,11 @@ save_hard_disks(void)
     char *p;
     int c;
 
+    if (hdd_cache_mode == HDD_CACHE_WRITETHROUGH)
+	config_delete_var(cat, "write_cache");
+      else
+	config_set_int(cat, "write_cache", hdd_cache_mode);
+
     memset(temp, 0x00, sizeof(temp));
     for (c=0; c<HDD_NUM; c++) {
 	sprintf(temp, "hdd_%02i_parameters", c+1);
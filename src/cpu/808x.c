@@ -99,6 +99,7 @@ static int in_rep = 0, repeating = 0;
 static int oldc, clear_lock = 0;
 static int refresh = 0, takeint = 0;
 static int cycdiff;
+static int32_t clock_left;
 
 
 /* Various things needed for 8087. */
@@ -224,13 +225,25 @@ irq_pending(void)
 }
 
 
+/* Recalculates how many tsc ticks are left until the next timer is due;
+   needed whenever tsc or timer_target may have changed. */
+static void
+clock_rearm(void)
+{
+    clock_left = (int32_t) (timer_target - (uint32_t) tsc);
+}
+
+
 static void
 clock_start(void)
 {
     cycdiff = cycles;
+    clock_rearm();
 }
 
 
+/* Brings tsc up to date with the cycles spent so far and runs any timers
+   that are due. */
 static void 
 clock_end(void)
 {
@@ -238,8 +251,21 @@ clock_end(void)
 
     /* On 808x systems, clock speed is usually crystal frequency divided by an integer. */
     tsc += (uint64_t)diff * ((uint64_t)xt_cpu_multi >> 32ULL);		/* Shift xt_cpu_multi by 32 bits to the right and then multiply. */
+    cycdiff = cycles;
     if (TIMER_VAL_LESS_THAN_VAL(timer_target, (uint32_t)tsc))
 	timer_process();
+    clock_rearm();
+}
+
+
+/* Called on every bus cycle. Rather than updating tsc each time, only
+   synchronize once the next timer is due; device accesses synchronize
+   explicitly through clock_end(). */
+static void
+clock_check(void)
+{
+    if (((int64_t) (cycdiff - cycles) * (int64_t) (xt_cpu_multi >> 32ULL)) >= clock_left)
+	clock_end();
 }
 
 
@@ -258,10 +284,8 @@ fetch_and_bus(int c, int bus)
     }
 
     pfq_add(c, !bus);
-    if (bus < 2) {
-	clock_end();
-	clock_start();
-    }
+    if (bus < 2)
+	clock_check();
 }
 
 
@@ -302,9 +326,11 @@ readmemb_common(uint32_t a)
     if (readlookup2 == NULL)
 	ret = readmembl(a);
     else {
-	if (readlookup2[(a) >> 12] == ((uintptr_t) -1))
+	if (readlookup2[(a) >> 12] == ((uintptr_t) -1)) {
+		clock_end();
 		ret = readmembl(a);
-	else
+		clock_rearm();
+	} else
 		ret = *(uint8_t *)(readlookup2[(a) >> 12] + (a));
     }
 
@@ -416,9 +442,11 @@ writememb_common(uint32_t a, uint8_t v)
     if (writelookup2 == NULL)
 	writemembl(a, v);
     else {
-	if (writelookup2[(a) >> 12] == ((uintptr_t) -1))
+	if (writelookup2[(a) >> 12] == ((uintptr_t) -1)) {
+		clock_end();
 		writemembl(a, v);
-	else
+		clock_rearm();
+	} else
 		*(uint8_t *)(writelookup2[a >> 12] + a) = v;
     }
 
@@ -567,7 +595,9 @@ pfq_fetch()
 }
 
 
-/* Adds bytes to the prefetch queue based on the instruction's cycle count. */
+/* Adds bytes to the prefetch queue based on the instruction's cycle count.
+   A fetch can only start on a bus cycle boundary, so step from boundary to
+   boundary rather than one clock at a time. */
 static void
 pfq_add(int c, int add)
 {
@@ -576,10 +606,20 @@ pfq_add(int c, int add)
     if ((c <= 0) || (pfq_pos >= pfq_size))
 	return;
 
-    for (d = 0; d < c; d++) {
-	biu_cycles = (biu_cycles + 1) & 0x03;
-	if (prefetching && add && (biu_cycles == 0x00))
-		pfq_write();
+    if (!prefetching || !add) {
+	biu_cycles = (biu_cycles + c) & 0x03;
+	return;
+    }
+
+    while (c > 0) {
+	d = 4 - biu_cycles;
+	if (d > c) {
+		biu_cycles = (biu_cycles + c) & 0x03;
+		break;
+	}
+	c -= d;
+	biu_cycles = 0x00;
+	pfq_write();
     }
 }
 
@@ -893,6 +933,7 @@ static void
 reset_common(int hard)
 {
     biu_cycles = 0;
+    cycdiff = cycles;
     in_rep = 0;
     in_lock = 0;
     completed = 1;
@@ -1761,11 +1802,13 @@ execx86(int cycs)
     uint16_t new_cs, new_ip;
     int bits;
 
+    /* Account for anything spent since the last run before adding the
+       new cycles, tsc is then kept in sync lazily by clock_check(). */
+    clock_end();
     cycles += cycs;
+    clock_start();
 
     while (cycles > 0) {
-	clock_start();
-
 	if (!repeating) {
 		cpu_state.oldpc = cpu_state.pc;
 		opcode = pfq_fetchb();
@@ -2620,13 +2663,16 @@ execx86(int cycs)
 			cpu_state.eaaddr = cpu_data;
 			if ((opcode & 2) == 0) {
 				access(3, bits);
+				clock_end();
 				if ((opcode & 1) && is8086 && !(cpu_data & 1)) {
 					AX = inw(cpu_data);
+					clock_rearm();
 					wait(4, 1);		/* I/O access and wait state. */
 				} else {
 					AL = inb(cpu_data);
 					if (opcode & 1)
 						AH = inb(cpu_data + 1);
+					clock_rearm();
 					wait(bits >> 1, 1);	/* I/O access. */
 				}
 				wait(1, 0);
@@ -2635,13 +2681,16 @@ execx86(int cycs)
 					access(8, bits);
 				else
 					access(9, bits);
+				clock_end();
 				if ((opcode & 1) && is8086 && !(cpu_data & 1)) {
 					outw(cpu_data, AX);
+					clock_rearm();
 					wait(4, 1);
 				} else {
 					outb(cpu_data, AL);
 					if (opcode & 1)
 						outb(cpu_data + 1, AH);
+					clock_rearm();
 					wait(bits >> 1, 1);	/* I/O access. */
 				}
 			}
@@ -2890,4 +2939,6 @@ execx86(int cycs)
 
 	ins++;
     }
+
+    clock_end();
 }
@@ -2303,12 +2303,14 @@ x86_setopcodes(const OpFn *opcodes, const OpFn *opcodes_0f,
         x86_opcodes_0f = opcodes_0f;
         x86_dynarec_opcodes = dynarec_opcodes;
         x86_dynarec_opcodes_0f = dynarec_opcodes_0f;
+        x386_icache_flush();
 }
 #else
 x86_setopcodes(const OpFn *opcodes, const OpFn *opcodes_0f)
 {
         x86_opcodes = opcodes;
         x86_opcodes_0f = opcodes_0f;
+        x386_icache_flush();
 }
 #endif
 
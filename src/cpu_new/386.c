@@ -181,6 +181,159 @@ fetch_ea_16_long(uint32_t rmdat)
 #include "x86_ops.h"
 
 
+/* Predecoded instruction cache.
+
+   For each RAM page code has run from, this keeps the handler and the
+   fetch data of every instruction start seen, so the next time round the
+   interpreter calls the handler directly instead of fetching the bytes
+   and going through the opcode table. Entries are keyed on the physical
+   page, so they survive paging changes, and are dropped by the page write
+   functions and mem_invalidate_range() when their bytes change; the pages
+   are made to take the slow write path for this while they are cached.
+
+   A hit stands in for a fastreadl() that would have hit pccache, so no
+   cycles are counted differently. */
+#define ICACHE_PAGES	64
+
+
+typedef struct {
+    OpFn	op;			/* NULL if not decoded */
+    uint32_t	op32,			/* size state it was decoded for */
+		fetchdat;		/* the bytes after the opcode */
+} icache_entry_t;
+
+typedef struct {
+    uint32_t	page;			/* RAM page + 1, 0 if free */
+    icache_entry_t e[4096];
+} icache_page_t;
+
+
+static icache_page_t	*icache = NULL;
+static int		icache_victim = 0;
+
+/* The page cs:pc is on, as of the last fill. icache_cur is NULL if it is
+   not cacheable. */
+static uint32_t		icache_virt = 0xffffffff;
+static uint8_t		*icache_host = NULL;
+static icache_entry_t	*icache_cur = NULL;
+
+
+void
+x386_icache_flush(void)
+{
+    int c;
+
+    if (icache != NULL) {
+	for (c = 0; c < ICACHE_PAGES; c++) {
+		if (icache[c].page && (pages != NULL))
+			pages[icache[c].page - 1].icache = 0;
+		icache[c].page = 0;
+	}
+    }
+
+    icache_virt = 0xffffffff;
+    icache_host = NULL;
+    icache_cur = NULL;
+}
+
+
+/* Bytes addr to addr + len - 1 of a cached page changed. */
+void
+x386_icache_write(int slot, uint32_t addr, int len)
+{
+    icache_entry_t *e = icache[slot - 1].e;
+    int c = (addr & 0xfff) - 3, end = (addr & 0xfff) + len;
+
+    if (c < 0)
+	c = 0;
+    if (end > 4096)
+	end = 4096;
+
+    for (; c < end; c++)
+	e[c].op = NULL;
+}
+
+
+static icache_entry_t *
+icache_page(uint32_t addr)
+{
+    icache_page_t *p;
+    int page, slot;
+
+    page = mem_code_ram_page(addr);
+    if (page < 0)
+	return(NULL);
+
+    if (icache == NULL) {
+	icache = (icache_page_t *) calloc(ICACHE_PAGES, sizeof(icache_page_t));
+	if (icache == NULL)
+		return(NULL);
+    }
+
+    if (pages[page].icache)
+	return(icache[pages[page].icache - 1].e);
+
+    slot = icache_victim;
+    icache_victim = (icache_victim + 1) % ICACHE_PAGES;
+
+    p = &icache[slot];
+    if (p->page)
+	pages[p->page - 1].icache = 0;
+    memset(p->e, 0x00, sizeof(p->e));
+    p->page = page + 1;
+
+    pages[page].icache = slot + 1;
+    mem_flush_write_ram_page(page << 12);
+
+    return(p->e);
+}
+
+
+static __inline icache_entry_t *
+icache_lookup(uint32_t addr)
+{
+    icache_entry_t *e;
+
+    if (((addr >> 12) != icache_virt) || (icache_virt != pccache) || (pccache2 != icache_host) ||
+	(icache_cur == NULL) || ((addr & 0xfff) >= 0xffd))
+	return(NULL);
+
+    e = &icache_cur[addr & 0xfff];
+    if ((e->op == NULL) || (e->op32 != cpu_state.op32))
+	return(NULL);
+
+    return(e);
+}
+
+
+/* Called after fastreadl() fetched the instruction at addr, so pccache
+   is loaded for it. */
+static void
+icache_fill(uint32_t addr, OpFn op, uint32_t fetchdat)
+{
+    icache_entry_t *e;
+
+    /* The fetch data ran into the next page, or did not come through
+       pccache. */
+    if (((addr & 0xfff) >= 0xffd) || ((addr >> 12) != pccache))
+	return;
+
+    if (((addr >> 12) != icache_virt) || (pccache2 != icache_host)) {
+	icache_virt = addr >> 12;
+	icache_host = pccache2;
+	icache_cur = icache_page(addr);
+    }
+
+    if (icache_cur == NULL)
+	return;
+
+    e = &icache_cur[addr & 0xfff];
+    e->op = op;
+    e->op32 = cpu_state.op32;
+    e->fetchdat = fetchdat;
+}
+
+
 void
 exec386(int cycs)
 {
@@ -188,6 +341,8 @@ exec386(int cycs)
     int vector, tempi, cycdiff, oldcyc;
     int cycle_period, ins_cycles;
     uint32_t addr;
+    icache_entry_t *e;
+    OpFn op;
 
     cycles += cycs;
 
@@ -206,17 +361,31 @@ exec386(int cycs)
 		cpu_state.ea_seg = &cpu_state.seg_ds;
 		cpu_state.ssegs = 0;
 
-		fetchdat = fastreadl(cs + cpu_state.pc);
-
-		if (!cpu_state.abrt) {
-			opcode = fetchdat & 0xFF;
-			fetchdat >>= 8;
+		addr = cs + cpu_state.pc;
+		e = icache_lookup(addr);
+		if (e != NULL) {
 			trap = cpu_state.flags & T_FLAG;
 
 			cpu_state.pc++;
-			x86_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
+			e->op(e->fetchdat);
 			if (x86_was_reset)
 				break;
+		} else {
+			fetchdat = fastreadl(addr);
+
+			if (!cpu_state.abrt) {
+				opcode = fetchdat & 0xFF;
+				fetchdat >>= 8;
+				trap = cpu_state.flags & T_FLAG;
+
+				op = x86_opcodes[(opcode | cpu_state.op32) & 0x3ff];
+				icache_fill(addr, op, fetchdat);
+
+				cpu_state.pc++;
+				op(fetchdat);
+				if (x86_was_reset)
+					break;
+			}
 		}
 
 		if (cpu_state.abrt) {
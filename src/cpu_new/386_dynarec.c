@@ -421,6 +421,9 @@ void exec386_dynarec(int cycs)
                                 {
                                         void (*code)() = (void *)&block->data[BLOCK_START];
 
+                                        if (block->hotness < CODEBLOCK_HOTNESS_MAX)
+                                                block->hotness++;
+
                                         inrecomp=1;
                                         code();
                                         inrecomp=0;
@@ -38,6 +38,9 @@ typedef struct codeblock_t
         uint16_t flags;
         uint8_t ins;
         uint8_t TOP;
+        /*Execution count since the eviction clock hand last passed this
+          block, saturating at CODEBLOCK_HOTNESS_MAX*/
+        uint8_t hotness;
 
         /*Pointers for codeblock tree, used to search for blocks when hash lookup
           fails.*/
@@ -333,9 +336,14 @@ void codegen_check_seg_read(codeblock_t *block, struct ir_data_t *ir, x86seg *se
 void codegen_check_seg_write(codeblock_t *block, struct ir_data_t *ir, x86seg *seg);
 
 int codegen_purge_purgable_list();
-/*Delete a random code block to free memory. This is obviously quite expensive, and
-  will only be called when the allocator is out of memory*/
-void codegen_delete_random_block(int required_mem_block);
+/*Evict a code block to free memory. A clock hand sweeps the code block array,
+  halving the hotness of each block it passes and evicting the first block it
+  finds with no executions since the previous sweep, so frequently executed
+  code survives cache pressure. Only called when the block free list or the
+  allocator is exhausted*/
+void codegen_evict_block(int required_mem_block);
+
+#define CODEBLOCK_HOTNESS_MAX 255
 
 extern int cpu_block_end;
 extern uint32_t codegen_endpc;
@@ -346,6 +354,7 @@ extern int cpu_recomp_flushes, cpu_recomp_flushes_latched;
 extern int cpu_recomp_evicted, cpu_recomp_evicted_latched;
 extern int cpu_recomp_reuse, cpu_recomp_reuse_latched;
 extern int cpu_recomp_removed, cpu_recomp_removed_latched;
+extern int cpu_recomp_cache_evicted;
 
 extern int cpu_reps, cpu_reps_latched;
 extern int cpu_notreps, cpu_notreps_latched;
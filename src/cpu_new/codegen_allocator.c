@@ -23,32 +23,49 @@ typedef struct mem_block_t
         uint16_t code_block;
 } mem_block_t;
 
-static mem_block_t mem_blocks[MEM_BLOCK_NR];
+static mem_block_t *mem_blocks = NULL;
 static uint32_t mem_block_free_list;
 static uint8_t *mem_block_alloc = NULL;
 
 int codegen_allocator_usage = 0;
+int codegen_allocator_nr = 0;
+int codegen_allocator_failures = 0;
+int codegen_cache_size = 0;
 
 void codegen_allocator_init()
 {
         int c;
 
+        /*Size the code cache from the configuration (in MB), bounded by the
+          branch range limit in MEM_BLOCK_NR*/
+        if (codegen_cache_size > 0)
+                codegen_allocator_nr = (int)(((uint64_t)codegen_cache_size << 20) / MEM_BLOCK_SIZE);
+        else
+                codegen_allocator_nr = MEM_BLOCK_NR;
+        if (codegen_allocator_nr < MEM_BLOCK_NR_MIN)
+                codegen_allocator_nr = MEM_BLOCK_NR_MIN;
+        if (codegen_allocator_nr > MEM_BLOCK_NR)
+                codegen_allocator_nr = MEM_BLOCK_NR;
+
+        mem_blocks = malloc(codegen_allocator_nr * sizeof(mem_block_t));
 #if defined WIN32 || defined _WIN32 || defined _WIN32
-        mem_block_alloc = VirtualAlloc(NULL, MEM_BLOCK_NR * MEM_BLOCK_SIZE, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+        mem_block_alloc = VirtualAlloc(NULL, codegen_allocator_nr * MEM_BLOCK_SIZE, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
 #else
-        mem_block_alloc = mmap(0, MEM_BLOCK_NR * MEM_BLOCK_SIZE, PROT_READ|PROT_WRITE|PROT_EXEC, MAP_ANON|MAP_PRIVATE, 0, 0);
+        mem_block_alloc = mmap(0, codegen_allocator_nr * MEM_BLOCK_SIZE, PROT_READ|PROT_WRITE|PROT_EXEC, MAP_ANON|MAP_PRIVATE, 0, 0);
 #endif
 
-        for (c = 0; c < MEM_BLOCK_NR; c++)
+        for (c = 0; c < codegen_allocator_nr; c++)
         {
                 mem_blocks[c].offset = c * MEM_BLOCK_SIZE;
                 mem_blocks[c].code_block = BLOCK_INVALID;
-                if (c < MEM_BLOCK_NR-1)
+                if (c < codegen_allocator_nr-1)
                         mem_blocks[c].next = c+2;
                 else
                         mem_blocks[c].next = 0;
         }
         mem_block_free_list = 1;
+        codegen_allocator_usage = 0;
+        codegen_allocator_failures = 0;
 }
 
 mem_block_t *codegen_allocator_allocate(mem_block_t *parent, int code_block)
@@ -56,14 +73,12 @@ mem_block_t *codegen_allocator_allocate(mem_block_t *parent, int code_block)
         mem_block_t *block;
         uint32_t block_nr;
         
+        if (!mem_block_free_list)
+                codegen_allocator_failures++;
         while (!mem_block_free_list)
         {
-                /*Pick a random memory block and free the owning code block*/
-                block_nr = rand() & MEM_BLOCK_MASK;
-                block = &mem_blocks[block_nr];
-                
-                if (block->code_block && block->code_block != code_block)
-                        codegen_delete_block(&codeblock[block->code_block]);
+                /*Evict the coldest code block that owns memory*/
+                codegen_evict_block(1);
         }
 
         /*Remove from free list*/
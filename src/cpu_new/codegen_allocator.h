@@ -19,7 +19,9 @@
 #define MEM_BLOCK_NR 131072
 #endif
 
-#define MEM_BLOCK_MASK (MEM_BLOCK_NR-1)
+/*Smallest code cache that will be allocated, regardless of configuration*/
+#define MEM_BLOCK_NR_MIN 4096
+
 #define MEM_BLOCK_SIZE 0x3c0
 
 void codegen_allocator_init();
@@ -35,5 +37,11 @@ uint8_t *codeblock_allocator_get_ptr(struct mem_block_t *block);
 void codegen_allocator_clean_blocks(struct mem_block_t *block);
 
 extern int codegen_allocator_usage;
+/*Number of memory blocks in the code cache*/
+extern int codegen_allocator_nr;
+/*Number of allocations that found the cache full and had to evict*/
+extern int codegen_allocator_failures;
+/*Configured code cache size in MB, 0 for the largest supported size*/
+extern int codegen_cache_size;
 
 #endif
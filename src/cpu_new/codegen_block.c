@@ -40,6 +40,7 @@ int cpu_recomp_flushes, cpu_recomp_flushes_latched;
 int cpu_recomp_evicted, cpu_recomp_evicted_latched;
 int cpu_recomp_reuse, cpu_recomp_reuse_latched;
 int cpu_recomp_removed, cpu_recomp_removed_latched;
+int cpu_recomp_cache_evicted;
 
 uint32_t codegen_endpc;
 
@@ -56,6 +57,7 @@ uint32_t instr_counts[256*256];
 #endif
 
 static uint16_t block_free_list;
+static int block_evict_hand;
 static void delete_block(codeblock_t *block);
 static void delete_dirty_block(codeblock_t *block);
 
@@ -193,7 +195,7 @@ static codeblock_t *block_free_list_get()
                 }
                 /*Free list is empty - free up a block*/
                 if (!codegen_purge_purgable_list())
-                        codegen_delete_random_block(0);
+                        codegen_evict_block(0);
         }
 
         block = &codeblock[block_free_list];
@@ -211,6 +213,7 @@ void codegen_init()
         
         codegen_backend_init();
         block_free_list = 0;
+        block_evict_hand = 0;
         for (c = 0; c < BLOCK_SIZE; c++)
                 block_free_list_add(&codeblock[c]);
         block_dirty_list_head = block_dirty_list_tail = 0;
@@ -444,23 +447,29 @@ void codegen_delete_block(codeblock_t *block)
                 delete_block(block);
 }
 
-void codegen_delete_random_block(int required_mem_block)
+void codegen_evict_block(int required_mem_block)
 {
-        int block_nr = rand() & BLOCK_MASK;
-        
         while (1)
         {
+                int block_nr = block_evict_hand = (block_evict_hand + 1) & BLOCK_MASK;
+
                 if (block_nr && block_nr != block_current)
                 {
                         codeblock_t *block = &codeblock[block_nr];
 
                         if (block->pc != BLOCK_PC_INVALID && (!required_mem_block || block->head_mem_block))
                         {
-                                delete_block(block);
-                                return;
+                                /*Age the block; hot blocks survive several passes*/
+                                if (block->hotness)
+                                        block->hotness >>= 1;
+                                else
+                                {
+                                        delete_block(block);
+                                        cpu_recomp_cache_evicted++;
+                                        return;
+                                }
                         }
                 }
-                block_nr = (block_nr + 1) & BLOCK_MASK;
         }
 }
 
@@ -534,6 +543,7 @@ void codegen_block_init(uint32_t phys_addr)
         codeblock_hash[block_num] = block_current;
 
         block->ins = 0;
+        block->hotness = 1;
         block->pc = cs + cpu_state.pc;
         block->_cs = cs;
         block->phys = phys_addr;
@@ -209,3 +209,69 @@ uint32_t ropPFRSQIT1(codeblock_t *block, ir_data_t *ir, uint8_t opcode, uint32_t
         codegen_mark_code_present(block, cs+op_pc, 2);
         return op_pc + 2;
 }
+
+uint32_t ropPFACC(codeblock_t *block, ir_data_t *ir, uint8_t opcode, uint32_t fetchdat, uint32_t op_32, uint32_t op_pc)
+{
+        int dest_reg = (fetchdat >> 3) & 7;
+        int src;
+
+        uop_MMX_ENTER(ir);
+        codegen_mark_code_present(block, cs+op_pc, 1);
+        if ((fetchdat & 0xc0) == 0xc0)
+        {
+                int src_reg = fetchdat & 7;
+                src = IREG_MM(src_reg);
+        }
+        else
+        {
+                x86seg *target_seg;
+
+                uop_MOV_IMM(ir, IREG_oldpc, cpu_state.oldpc);
+                target_seg = codegen_generate_ea(ir, op_ea_seg, fetchdat, op_ssegs, &op_pc, op_32, 0);
+                codegen_check_seg_read(block, ir, target_seg);
+                uop_MEM_LOAD_REG(ir, IREG_temp0_Q, ireg_seg_base(target_seg), IREG_eaaddr);
+                src = IREG_temp0_Q;
+        }
+        /*Split into {dest.f[0], src.f[0]} and {dest.f[1], src.f[1]}, then
+          a single packed add produces both horizontal sums*/
+        uop_MOV(ir, IREG_temp1_Q, IREG_MM(dest_reg));
+        uop_PUNPCKHDQ(ir, IREG_temp1_Q, IREG_temp1_Q, src);
+        uop_PUNPCKLDQ(ir, IREG_MM(dest_reg), IREG_MM(dest_reg), src);
+        uop_PFADD(ir, IREG_MM(dest_reg), IREG_MM(dest_reg), IREG_temp1_Q);
+
+        codegen_mark_code_present(block, cs+op_pc+1, 1);
+        return op_pc + 2;
+}
+
+uint32_t ropPMULHRW(codeblock_t *block, ir_data_t *ir, uint8_t opcode, uint32_t fetchdat, uint32_t op_32, uint32_t op_pc)
+{
+        int dest_reg = (fetchdat >> 3) & 7;
+        int src;
+
+        uop_MMX_ENTER(ir);
+        codegen_mark_code_present(block, cs+op_pc, 1);
+        if ((fetchdat & 0xc0) == 0xc0)
+        {
+                int src_reg = fetchdat & 7;
+                src = IREG_MM(src_reg);
+        }
+        else
+        {
+                x86seg *target_seg;
+
+                uop_MOV_IMM(ir, IREG_oldpc, cpu_state.oldpc);
+                target_seg = codegen_generate_ea(ir, op_ea_seg, fetchdat, op_ssegs, &op_pc, op_32, 0);
+                codegen_check_seg_read(block, ir, target_seg);
+                uop_MEM_LOAD_REG(ir, IREG_temp0_Q, ireg_seg_base(target_seg), IREG_eaaddr);
+                src = IREG_temp0_Q;
+        }
+        /*(a*b + 0x8000) >> 16 == high word of a*b, plus bit 15 of the low word*/
+        uop_MOV(ir, IREG_temp1_Q, IREG_MM(dest_reg));
+        uop_PMULLW(ir, IREG_temp1_Q, IREG_temp1_Q, src);
+        uop_PSRLW_IMM(ir, IREG_temp1_Q, IREG_temp1_Q, 15);
+        uop_PMULHW(ir, IREG_MM(dest_reg), IREG_MM(dest_reg), src);
+        uop_PADDW(ir, IREG_MM(dest_reg), IREG_MM(dest_reg), IREG_temp1_Q);
+
+        codegen_mark_code_present(block, cs+op_pc+1, 1);
+        return op_pc + 2;
+}
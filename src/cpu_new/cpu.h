@@ -458,6 +458,8 @@ extern void	cpu_set_edx(void);
 extern int	divl(uint32_t val);
 extern void	execx86(int cycs);
 extern void	exec386(int cycs);
+extern void	x386_icache_flush(void);
+extern void	x386_icache_write(int slot, uint32_t addr, int len);
 extern void	exec386_dynarec(int cycs);
 extern int	idivl(int32_t val);
 void pmodeint(int num, int soft);
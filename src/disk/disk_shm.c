@@ -0,0 +1,312 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		Shared image block cache.
+ *
+ *		Many instances started off the same read-only image all
+ *		read the same blocks of it. This keeps a block cache for
+ *		such an image in named shared memory, one region per image,
+ *		named after the file's identity (volume, file index, size
+ *		and modification time) so any 86Box process on the host that
+ *		opens the same unchanged file finds the same region, and each
+ *		block only has to come off the disk once per host.
+ *
+ *		The region is a set-associative cache of fixed-size blocks
+ *		of the image file, guarded by a named mutex. Misses are read
+ *		outside the lock; a generation counter bumped on every write
+ *		keeps a slow reader from installing data that a writer has
+ *		replaced in the meantime.
+ *
+ * Version:	@(#)disk_shm.c	1.0.0	2020/01/28
+ */
+#define _LARGEFILE_SOURCE
+#define _LARGEFILE64_SOURCE
+#define __STDC_FORMAT_MACROS
+#include <stdarg.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include "../86box.h"
+#include "../plat.h"
+#include "disk_shm.h"
+
+
+#define SHM_MAGIC	0x4d485344	/* 'DSHM' */
+
+
+typedef struct {
+    uint32_t	magic, block_size,
+		sets, pad;
+    uint64_t	gen;			/* bumped on every invalidation */
+    uint64_t	hits, misses;		/* host-wide */
+} shm_hdr_t;
+
+typedef struct {
+    uint64_t	tag[DISK_SHM_WAYS];	/* block number + 1, 0 if empty */
+    uint32_t	len[DISK_SHM_WAYS];	/* short at the end of the file */
+    uint32_t	victim, pad;
+} shm_set_t;
+
+typedef struct {
+    shm_hdr_t	*hdr;
+    shm_set_t	*sets;
+    uint8_t	*data;
+    mutex_t	*lock;
+
+    uint32_t	nsets;
+    uint64_t	hits, misses;		/* this process only */
+} disk_shm_t;
+
+
+int		disk_shm_size = 0;
+
+
+#ifdef ENABLE_DISK_SHM_LOG
+int disk_shm_do_log = ENABLE_DISK_SHM_LOG;
+
+
+static void
+disk_shm_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (disk_shm_do_log) {
+	va_start(ap, fmt);
+	pclog_ex(fmt, ap);
+	va_end(ap);
+    }
+}
+#else
+#define disk_shm_log(fmt, ...)
+#endif
+
+
+static uint32_t
+shm_set(disk_shm_t *dev, uint64_t block)
+{
+    return((uint32_t) (((block + 1) * 0x9e3779b97f4a7c15ULL) >> 32) % dev->nsets);
+}
+
+
+static int
+shm_lookup(shm_set_t *s, uint64_t block)
+{
+    int i;
+
+    for (i = 0; i < DISK_SHM_WAYS; i++) {
+	if (s->tag[i] == (block + 1))
+		return(i);
+    }
+
+    return(-1);
+}
+
+
+static uint8_t *
+shm_block(disk_shm_t *dev, uint32_t set, int way)
+{
+    return(dev->data + ((((uint64_t) set * DISK_SHM_WAYS) + way) * DISK_SHM_BLOCK));
+}
+
+
+void *
+disk_shm_open(const wchar_t *fn)
+{
+    disk_shm_t *dev;
+    wchar_t name[64], lock_name[72];
+    uint64_t id, data_off, size;
+    uint32_t nsets;
+    void *p;
+
+    if (disk_shm_size <= 0)
+	return(NULL);
+
+    if (! plat_file_id(fn, &id)) {
+	disk_shm_log("SHM: Unable to identify %ls\n", fn);
+	return(NULL);
+    }
+
+    nsets = (uint32_t) ((((uint64_t) disk_shm_size) << 20) / (DISK_SHM_BLOCK * DISK_SHM_WAYS));
+    if (nsets == 0)
+	nsets = 1;
+    data_off = (sizeof(shm_hdr_t) + (nsets * sizeof(shm_set_t)) + 4095) & ~4095ULL;
+    size = data_off + ((uint64_t) nsets * DISK_SHM_WAYS * DISK_SHM_BLOCK);
+
+    /* The size is part of the name, so instances configured with
+       different sizes simply do not share. */
+    swprintf(name, sizeof_w(name), L"Local\\86Box-shm-%08x%08x-%i",
+	     (uint32_t) (id >> 32), (uint32_t) id, disk_shm_size);
+
+    p = plat_shm_open(name, size);
+    if (p == NULL) {
+	disk_shm_log("SHM: Unable to map %ls for %ls\n", name, fn);
+	return(NULL);
+    }
+
+    dev = (disk_shm_t *) malloc(sizeof(disk_shm_t));
+    memset(dev, 0x00, sizeof(disk_shm_t));
+
+    swprintf(lock_name, sizeof_w(lock_name), L"%ls-lock", name);
+    dev->lock = thread_create_mutex(lock_name);
+    if (dev->lock == NULL) {
+	plat_shm_close(p);
+	free(dev);
+	return(NULL);
+    }
+
+    dev->hdr = (shm_hdr_t *) p;
+    dev->sets = (shm_set_t *) (dev->hdr + 1);
+    dev->data = ((uint8_t *) p) + data_off;
+    dev->nsets = nsets;
+
+    /* Whoever maps it first sets it up; new mappings come zeroed. */
+    thread_wait_mutex(dev->lock);
+    if ((dev->hdr->magic != SHM_MAGIC) || (dev->hdr->block_size != DISK_SHM_BLOCK) ||
+	(dev->hdr->sets != nsets)) {
+	memset(p, 0x00, (size_t) data_off);
+	dev->hdr->magic = SHM_MAGIC;
+	dev->hdr->block_size = DISK_SHM_BLOCK;
+	dev->hdr->sets = nsets;
+    }
+    thread_release_mutex(dev->lock);
+
+    disk_shm_log("SHM: %ls shared as %ls (%i MB)\n", fn, name, disk_shm_size);
+
+    return(dev);
+}
+
+
+void
+disk_shm_close(void *p)
+{
+    disk_shm_t *dev = (disk_shm_t *) p;
+
+    if (dev == NULL)
+	return;
+
+    disk_shm_log("SHM: Closed, %" PRIu64 " hits, %" PRIu64 " misses "
+		 "(host: %" PRIu64 " hits, %" PRIu64 " misses)\n",
+		 dev->hits, dev->misses, dev->hdr->hits, dev->hdr->misses);
+
+    plat_shm_close(dev->hdr);
+    thread_close_mutex(dev->lock);
+
+    free(dev);
+}
+
+
+/* Read len bytes at offset in the image file through the cache, and
+   return how many could be read. */
+uint32_t
+disk_shm_read(void *p, FILE *f, uint8_t *buffer, uint64_t offset, uint32_t len)
+{
+    disk_shm_t *dev = (disk_shm_t *) p;
+    uint64_t block, gen;
+    uint32_t set, boff, n, blen, done = 0;
+    uint8_t *tmp = NULL;
+    shm_set_t *s;
+    int way;
+
+    while (done < len) {
+	block = (offset + done) / DISK_SHM_BLOCK;
+	boff = (uint32_t) ((offset + done) % DISK_SHM_BLOCK);
+	n = MIN(len - done, DISK_SHM_BLOCK - boff);
+	set = shm_set(dev, block);
+	s = &dev->sets[set];
+
+	/* An abandoned mutex is still ours, so the result is not checked. */
+	thread_wait_mutex(dev->lock);
+	way = shm_lookup(s, block);
+	if (way >= 0) {
+		blen = s->len[way];
+		if (boff < blen)
+			memcpy(buffer + done, shm_block(dev, set, way) + boff, MIN(n, blen - boff));
+		dev->hdr->hits++;
+		thread_release_mutex(dev->lock);
+		dev->hits++;
+	} else {
+		gen = dev->hdr->gen;
+		dev->hdr->misses++;
+		thread_release_mutex(dev->lock);
+		dev->misses++;
+
+		if (tmp == NULL) {
+			/* The CD audio thread reads through here too, so
+			   no buffer is kept in the handle. */
+			tmp = (uint8_t *) malloc(DISK_SHM_BLOCK);
+			if (tmp == NULL)
+				break;
+		}
+
+		fseeko64(f, block * DISK_SHM_BLOCK, SEEK_SET);
+		blen = (uint32_t) fread(tmp, 1, DISK_SHM_BLOCK, f);
+
+		thread_wait_mutex(dev->lock);
+		if ((blen != 0) && (dev->hdr->gen == gen) && (shm_lookup(s, block) < 0)) {
+			way = s->victim;
+			s->victim = (way + 1) % DISK_SHM_WAYS;
+
+			/* Clear the tag first, so a process dying half way
+			   through leaves an empty entry rather than a torn one. */
+			s->tag[way] = 0;
+			memcpy(shm_block(dev, set, way), tmp, blen);
+			s->len[way] = blen;
+			s->tag[way] = block + 1;
+		}
+		thread_release_mutex(dev->lock);
+
+		if (boff < blen)
+			memcpy(buffer + done, tmp + boff, MIN(n, blen - boff));
+	}
+
+	if ((boff + n) > blen) {
+		/* End of the file. */
+		if (boff < blen)
+			done += (blen - boff);
+		break;
+	}
+
+	done += n;
+    }
+
+    free(tmp);
+
+    return(done);
+}
+
+
+/* Drop the cached blocks covering a range that was just written to the
+   file. The write must already have been flushed out of stdio, so that
+   anyone missing afterwards reads the new data. */
+void
+disk_shm_invalidate(void *p, uint64_t offset, uint32_t len)
+{
+    disk_shm_t *dev = (disk_shm_t *) p;
+    uint64_t block, last;
+    shm_set_t *s;
+    int way;
+
+    if ((dev == NULL) || (len == 0))
+	return;
+
+    last = (offset + len - 1) / DISK_SHM_BLOCK;
+
+    thread_wait_mutex(dev->lock);
+    dev->hdr->gen++;
+    for (block = offset / DISK_SHM_BLOCK; block <= last; block++) {
+	s = &dev->sets[shm_set(dev, block)];
+	way = shm_lookup(s, block);
+	if (way >= 0)
+		s->tag[way] = 0;
+    }
+    thread_release_mutex(dev->lock);
+}
@@ -0,0 +1,31 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		Definitions for the shared image block cache.
+ *
+ * Version:	@(#)disk_shm.h	1.0.0	2020/01/28
+ */
+#ifndef DISK_SHM_H
+# define DISK_SHM_H
+
+
+#define DISK_SHM_BLOCK		32768	/* bytes per cached block */
+#define DISK_SHM_WAYS		4	/* blocks per set */
+
+
+extern int	disk_shm_size;			/* (C) MB per image, 0 = off */
+
+
+extern void	*disk_shm_open(const wchar_t *fn);
+extern void	disk_shm_close(void *p);
+extern uint32_t	disk_shm_read(void *p, FILE *f, uint8_t *buffer,
+			      uint64_t offset, uint32_t len);
+extern void	disk_shm_invalidate(void *p, uint64_t offset, uint32_t len);
+
+
+#endif	/*DISK_SHM_H*/
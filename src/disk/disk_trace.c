@@ -0,0 +1,273 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		Storage I/O statistics.
+ *
+ *		The image backends report every file access they make, with
+ *		its size and the host time it took; the drive emulations
+ *		report when they accept a command from the guest and when it
+ *		completes, timed in emulated time. Everything is kept as
+ *		counters and power-of-two latency histograms per drive, and
+ *		written out as JSON on request or at exit.
+ *
+ *		The command hooks run on the emulation thread only, but the
+ *		CD audio thread reads sectors too, so the host side counters
+ *		are kept under a lock.
+ *
+ * Version:	@(#)disk_trace.c	1.0.0	2020/01/26
+ */
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include "../86box.h"
+#include "../timer.h"
+#include "../plat.h"
+#include "disk_trace.h"
+
+
+typedef struct {
+    uint64_t	count, total_us, max_us,
+		hist[DTRACE_BUCKETS];
+} dtrace_time_t;
+
+typedef struct {
+    uint64_t	bytes, errors;
+    dtrace_time_t t;
+} dtrace_op_t;
+
+typedef struct {
+    dtrace_op_t	ops[DTRACE_OPS];
+
+    dtrace_time_t cmd;
+    uint64_t	abandoned;
+    uint64_t	cmd_start;		/* in emulated CPU cycles */
+    int		pending;
+} dtrace_unit_t;
+
+typedef struct {
+    dtrace_unit_t units[DTRACE_UNITS];
+
+    int		depth, max_depth;	/* units with a command outstanding */
+    uint64_t	depth_hist[DTRACE_DEPTHS];
+} dtrace_class_t;
+
+
+static const char *class_names[DTRACE_CLASSES] = { "hdd", "cdrom", "zip", "fdd" };
+static const char *op_names[DTRACE_OPS] = { "read", "write", "zero", "flush" };
+
+
+wchar_t		disk_trace_path[1024];
+
+static dtrace_class_t classes[DTRACE_CLASSES];
+static mutex_t	*dtrace_lock = NULL;
+
+
+static void
+dtrace_time_add(dtrace_time_t *t, uint64_t us)
+{
+    int b = 0;
+
+    while ((b < (DTRACE_BUCKETS - 1)) && ((uint64_t) 1 << (b + 1)) <= us)
+	b++;
+
+    t->count++;
+    t->total_us += us;
+    if (us > t->max_us)
+	t->max_us = us;
+    t->hist[b]++;
+}
+
+
+static dtrace_unit_t *
+dtrace_unit(int cls, int unit)
+{
+    if ((cls < 0) || (cls >= DTRACE_CLASSES) || (unit < 0) || (unit >= DTRACE_UNITS))
+	return(NULL);
+
+    return(&classes[cls].units[unit]);
+}
+
+
+uint64_t
+disk_trace_start(void)
+{
+    return(plat_timer_read());
+}
+
+
+void
+disk_trace_end(int cls, int unit, int op, uint32_t bytes, uint64_t start, int error)
+{
+    dtrace_unit_t *u = dtrace_unit(cls, unit);
+    uint64_t us = 0;
+
+    if ((u == NULL) || (op < 0) || (op >= DTRACE_OPS))
+	return;
+
+    if (timer_freq)
+	us = ((plat_timer_read() - start) * 1000000ULL) / timer_freq;
+
+    thread_wait_mutex(dtrace_lock);
+    u->ops[op].bytes += bytes;
+    if (error)
+	u->ops[op].errors++;
+    dtrace_time_add(&u->ops[op].t, us);
+    thread_release_mutex(dtrace_lock);
+}
+
+
+void
+disk_trace_cmd_start(int cls, int unit)
+{
+    dtrace_unit_t *u = dtrace_unit(cls, unit);
+    dtrace_class_t *c;
+
+    if (u == NULL)
+	return;
+
+    c = &classes[cls];
+
+    /* A command that never completed was dropped by a reset or abort;
+       time the new one instead. */
+    if (u->pending)
+	u->abandoned++;
+    else {
+	u->pending = 1;
+	c->depth++;
+	if (c->depth > c->max_depth)
+		c->max_depth = c->depth;
+    }
+
+    c->depth_hist[MIN(c->depth, DTRACE_DEPTHS) - 1]++;
+
+    u->cmd_start = tsc;
+}
+
+
+void
+disk_trace_cmd_end(int cls, int unit)
+{
+    dtrace_unit_t *u = dtrace_unit(cls, unit);
+    uint64_t us = 0;
+
+    if ((u == NULL) || !u->pending)
+	return;
+
+    u->pending = 0;
+    classes[cls].depth--;
+
+    if (TIMER_USEC)
+	us = (uint64_t) (((double) (tsc - u->cmd_start) * 4294967296.0) / (double) TIMER_USEC);
+    dtrace_time_add(&u->cmd, us);
+}
+
+
+void
+disk_trace_init(void)
+{
+    if (dtrace_lock == NULL)
+	dtrace_lock = thread_create_mutex(NULL);
+}
+
+
+void
+disk_trace_reset(void)
+{
+    thread_wait_mutex(dtrace_lock);
+    memset(classes, 0x00, sizeof(classes));
+    thread_release_mutex(dtrace_lock);
+}
+
+
+static void
+dtrace_write_time(FILE *f, dtrace_time_t *t)
+{
+    int i, last;
+
+    /* Leave out the empty buckets at the top. */
+    for (last = DTRACE_BUCKETS - 1; (last > 0) && !t->hist[last]; last--)
+	;
+
+    fprintf(f, "\"count\": %llu, \"total_us\": %llu, \"max_us\": %llu, \"hist_log2_us\": [",
+	    (unsigned long long) t->count, (unsigned long long) t->total_us,
+	    (unsigned long long) t->max_us);
+    for (i = 0; i <= last; i++)
+	fprintf(f, "%s%llu", i ? ", " : "", (unsigned long long) t->hist[i]);
+    fprintf(f, "]");
+}
+
+
+int
+disk_trace_save(wchar_t *fn)
+{
+    dtrace_class_t *c;
+    dtrace_unit_t *u;
+    FILE *f;
+    int i, j, k, used, first = 1;
+
+    f = plat_fopen(fn, L"w");
+    if (f == NULL)
+	return(0);
+
+    thread_wait_mutex(dtrace_lock);
+
+    fprintf(f, "{\n  \"devices\": [");
+    for (i = 0; i < DTRACE_CLASSES; i++) {
+	for (j = 0; j < DTRACE_UNITS; j++) {
+		u = &classes[i].units[j];
+
+		used = (u->cmd.count != 0);
+		for (k = 0; k < DTRACE_OPS; k++)
+			used |= (u->ops[k].t.count != 0);
+		if (! used)
+			continue;
+
+		fprintf(f, "%s\n    { \"class\": \"%s\", \"unit\": %i,\n",
+			first ? "" : ",", class_names[i], j);
+		first = 0;
+
+		fprintf(f, "      \"host\": {");
+		for (k = 0; k < DTRACE_OPS; k++) {
+			fprintf(f, "%s\n        \"%s\": { \"bytes\": %llu, \"errors\": %llu, ",
+				k ? "," : "", op_names[k],
+				(unsigned long long) u->ops[k].bytes,
+				(unsigned long long) u->ops[k].errors);
+			dtrace_write_time(f, &u->ops[k].t);
+			fprintf(f, " }");
+		}
+		fprintf(f, "\n      },\n");
+
+		fprintf(f, "      \"guest\": { \"abandoned\": %llu, ",
+			(unsigned long long) u->abandoned);
+		dtrace_write_time(f, &u->cmd);
+		fprintf(f, " }\n    }");
+	}
+    }
+    fprintf(f, "\n  ],\n");
+
+    fprintf(f, "  \"queue_depth\": {");
+    for (i = 0; i < DTRACE_CLASSES; i++) {
+	c = &classes[i];
+	fprintf(f, "%s\n    \"%s\": { \"max\": %i, \"hist\": [", i ? "," : "",
+		class_names[i], c->max_depth);
+	for (k = 0; k < DTRACE_DEPTHS; k++)
+		fprintf(f, "%s%llu", k ? ", " : "", (unsigned long long) c->depth_hist[k]);
+	fprintf(f, "] }");
+    }
+    fprintf(f, "\n  }\n}\n");
+
+    thread_release_mutex(dtrace_lock);
+
+    fclose(f);
+
+    return(1);
+}
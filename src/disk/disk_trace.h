@@ -0,0 +1,55 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		Definitions for the storage I/O statistics.
+ *
+ * Version:	@(#)disk_trace.h	1.0.0	2020/01/26
+ */
+#ifndef DISK_TRACE_H
+# define DISK_TRACE_H
+
+
+/* Device classes. */
+#define DTRACE_HDD		0
+#define DTRACE_CDROM		1
+#define DTRACE_ZIP		2
+#define DTRACE_FDD		3
+#define DTRACE_CLASSES		4
+
+#define DTRACE_UNITS		32	/* per class */
+
+/* Host operations. */
+#define DTRACE_READ		0
+#define DTRACE_WRITE		1
+#define DTRACE_ZERO		2
+#define DTRACE_FLUSH		3
+#define DTRACE_OPS		4
+
+#define DTRACE_BUCKETS		24	/* powers of two microseconds */
+#define DTRACE_DEPTHS		4	/* 1, 2, 3, 4 or more */
+
+
+extern wchar_t	disk_trace_path[1024];		/* (O) file to save to at exit */
+
+
+/* Time a host operation: take the start with disk_trace_start(), then
+   pass it to disk_trace_end() once the file access is done. */
+extern uint64_t	disk_trace_start(void);
+extern void	disk_trace_end(int cls, int unit, int op, uint32_t bytes,
+			       uint64_t start, int error);
+
+/* Time a guest command, from the device accepting it to completion. */
+extern void	disk_trace_cmd_start(int cls, int unit);
+extern void	disk_trace_cmd_end(int cls, int unit);
+
+extern void	disk_trace_init(void);
+extern void	disk_trace_reset(void);
+extern int	disk_trace_save(wchar_t *fn);
+
+
+#endif	/*DISK_TRACE_H*/
@@ -45,6 +45,7 @@
 #include "hdc.h"
 #include "hdc_ide.h"
 #include "hdd.h"
+#include "disk_trace.h"
 #include "zip.h"
 
 
@@ -97,14 +98,17 @@
 #define WIN_SETIDLE1			0xE3
 #define WIN_CHECKPOWERMODE1		0xE5
 #define WIN_SLEEP1			0xE6
+#define WIN_FLUSH_CACHE			0xE7
 #define WIN_IDENTIFY			0xEC /* Ask drive to identify itself */
 #define WIN_SET_FEATURES		0xEF
 #define WIN_READ_NATIVE_MAX		0xF8
 
+#define FEATURE_ENABLE_WRITE_CACHE	0x02
 #define FEATURE_SET_TRANSFER_MODE	0x03
 #define FEATURE_ENABLE_IRQ_OVERLAPPED	0x5d
 #define FEATURE_ENABLE_IRQ_SERVICE	0x5e
 #define FEATURE_DISABLE_REVERT		0x66
+#define FEATURE_DISABLE_WRITE_CACHE	0x82
 #define FEATURE_ENABLE_REVERT		0xcc
 #define FEATURE_DISABLE_IRQ_OVERLAPPED	0xdd
 #define FEATURE_DISABLE_IRQ_SERVICE	0xde
@@ -289,6 +293,10 @@ ide_irq_raise(ide_t *ide)
 
     ide->irqstat = 1;
     ide->service = 1;
+
+    /* For hard disks, a command is timed up to its first interrupt. */
+    if (ide->type == IDE_HDD)
+	disk_trace_cmd_end(DTRACE_HDD, ide->hdd_num);
 }
 
 
@@ -525,10 +533,23 @@ static void ide_hd_identify(ide_t *ide)
 	ide_log("Current CHS translation: %i, %i, %i\n", ide->buffer[54], ide->buffer[55], ide->buffer[56]);
     }
 
+    /* Only bus mastering controllers report the write cache, so the
+       drive holds writes back only on those. */
+    hdd_image_report_write_cache(ide->hdd_num, ide_bm[ide->board] != NULL);
+
     if (ide_bm[ide->board]) {
 	ide->buffer[47] = 32 | 0x8000;  /*Max sectors on multiple transfer command*/
 	ide->buffer[80] = 0x1e; /*ATA-1 to ATA-4 supported*/
 	ide->buffer[81] = 0x18; /*ATA-4 revision 18 supported*/
+	if (hdd_cache_mode != HDD_CACHE_WRITETHROUGH) {
+		/* Report the write cache, so the guest flushes it. */
+		ide->buffer[82] = 0x0020; /*Write cache supported*/
+		ide->buffer[83] = 0x4000;
+		ide->buffer[84] = 0x4000;
+		if (hdd_image_get_write_cache(ide->hdd_num))
+			ide->buffer[85] = 0x0020; /*Write cache enabled*/
+		ide->buffer[87] = 0x4000;
+	}
     } else {
 	ide->buffer[47] = 16 | 0x8000;  /*Max sectors on multiple transfer command*/
 	ide->buffer[80] = 0x0e; /*ATA-1 to ATA-3 supported*/
@@ -774,6 +795,16 @@ ide_set_features(ide_t *ide)
 	case FEATURE_ENABLE_REVERT:	/* Enable reverting to power on defaults. */
 		return 1;
 
+	case FEATURE_ENABLE_WRITE_CACHE:
+	case FEATURE_DISABLE_WRITE_CACHE:
+		/* Only where IDENTIFY reports the write cache. */
+		if ((ide->type != IDE_HDD) || !ide_bm[ide->board] ||
+		    (hdd_cache_mode == HDD_CACHE_WRITETHROUGH))
+			return 0;
+		ide_log("IDE %02X: %sabling write cache\n", ide->channel,
+			(features == FEATURE_ENABLE_WRITE_CACHE) ? "En" : "Dis");
+		return hdd_image_set_write_cache(ide->hdd_num, features == FEATURE_ENABLE_WRITE_CACHE);
+
 	default:
 		return 0;
     }
@@ -1424,6 +1455,9 @@ ide_writeb(uint16_t addr, uint8_t val, void *priv)
 		ide_irq_lower(ide);
 		ide->command = val;
 
+		if (ide->type == IDE_HDD)
+			disk_trace_cmd_start(DTRACE_HDD, ide->hdd_num);
+
 		ide->error = 0;
 		if (ide->type == IDE_ATAPI)
 			ide->sc->error = 0;
@@ -1510,6 +1544,7 @@ ide_writeb(uint16_t addr, uint8_t val, void *priv)
 			case WIN_WRITE_DMA_ALT:
 			case WIN_VERIFY:
 			case WIN_VERIFY_ONCE:
+			case WIN_FLUSH_CACHE:
 			case WIN_IDENTIFY: /* Identify Device */
 			case WIN_SET_FEATURES: /* Set Features */
 			case WIN_READ_NATIVE_MAX:
@@ -2192,6 +2227,15 @@ ide_callback(void *priv)
 		ui_sb_update_icon(SB_HDD | hdd[ide->hdd_num].bus, 1);
 		return;
 
+	case WIN_FLUSH_CACHE:
+		if (ide->type != IDE_HDD)
+			goto abort_cmd;
+		if (! hdd_image_flush(ide->hdd_num))
+			goto abort_cmd;
+		ide->atastat = DRDY_STAT | DSC_STAT;
+		ide_irq_raise(ide);
+		return;
+
 	case WIN_FORMAT:
 		if (ide->type == IDE_ATAPI)
 			goto abort_cmd;
@@ -72,6 +72,12 @@ enum {
 #endif
 
 
+/* Host write cache policies. */
+#define HDD_CACHE_WRITETHROUGH	0	/* every write goes to the image */
+#define HDD_CACHE_WRITEBACK	1	/* writes wait for a guest flush */
+#define HDD_CACHE_UNSAFE	2	/* guest flushes are ignored */
+
+
 /* Define the virtual Hard Disk. */
 typedef struct {
     uint8_t	id;
@@ -100,6 +106,7 @@ typedef struct {
 
 extern hard_disk_t      hdd[HDD_NUM];
 extern unsigned int	hdd_table[128][3];
+extern int		hdd_cache_mode;
 
 
 typedef struct vhd_footer_t
@@ -145,6 +152,10 @@ extern uint32_t	hdd_image_get_last_sector(uint8_t id);
 extern uint32_t	hdd_image_get_pos(uint8_t id);
 extern uint8_t	hdd_image_get_type(uint8_t id);
 extern void	hdd_image_unload(uint8_t id, int fn_preserve);
+extern int	hdd_image_flush(uint8_t id);
+extern int	hdd_image_get_write_cache(uint8_t id);
+extern void	hdd_image_report_write_cache(uint8_t id, int report);
+extern int	hdd_image_set_write_cache(uint8_t id, int enable);
 extern void	hdd_image_close(uint8_t id);
 extern void	hdd_image_calc_chs(uint32_t *c, uint32_t *h, uint32_t *s, uint32_t size);
 
@@ -156,6 +167,17 @@ extern void	generate_vhd_checksum(vhd_footer_t *vhd);
 extern int	image_is_hdi(const wchar_t *s);
 extern int	image_is_hdx(const wchar_t *s, int check_signature);
 extern int	image_is_vhd(const wchar_t *s, int check_signature);
+extern int	image_is_hdz(const wchar_t *s, int check_signature);
+
+extern int	hdz_create(const wchar_t *fn, uint64_t sectors, uint32_t spt, uint32_t hpc, uint32_t tracks);
+extern void	*hdz_open(const wchar_t *fn, int read_only);
+extern void	hdz_close(void *p);
+extern uint64_t	hdz_get_sectors(void *p);
+extern void	hdz_get_geometry(void *p, uint32_t *spt, uint32_t *hpc, uint32_t *tracks);
+extern int	hdz_read(void *p, uint32_t sector, uint32_t count, uint8_t *buffer);
+extern int	hdz_write(void *p, uint32_t sector, uint32_t count, uint8_t *buffer);
+extern int	hdz_flush(void *p);
+extern int	hdz_convert(const wchar_t *in, const wchar_t *out);
 
 
 #endif	/*EMU_HDD_H*/
@@ -32,19 +32,43 @@
 #include "../plat.h"
 #include "../random.h"
 #include "hdd.h"
+#include "disk_trace.h"
+#include "disk_shm.h"
 
 
+#define HDD_WBC_SHIFT		6		/* 64 sectors per block */
+#define HDD_WBC_SECTORS		(1 << HDD_WBC_SHIFT)
+#define HDD_WBC_BLOCKS		512		/* 16 MB of dirty data */
+#define HDD_WBC_SLOTS		(HDD_WBC_BLOCKS << 1)
+
+
+/* A block of the write-back cache. */
+typedef struct
+{
+    uint32_t tag;		/* block number + 1, 0 if free */
+    uint32_t idx;		/* into the data pool */
+    uint64_t dirty;		/* one bit per sector */
+} hdd_wbc_t;
+
 typedef struct
 {
     FILE *file;
+    void *hdz;
+    void *shm;
+    hdd_wbc_t *wbc;
+    uint8_t *wbc_data;
+    uint32_t wbc_used;
     uint32_t base;
     uint32_t pos, last_sector;
     uint8_t type;
     uint8_t loaded;    
+    uint8_t wc_avail;		/* controller reports the write cache */
+    uint8_t wc_off;		/* write cache turned off by the guest */
 } hdd_image_t;
 
 
 hdd_image_t hdd_images[HDD_NUM];
+int hdd_cache_mode = HDD_CACHE_WRITETHROUGH;
 
 static char empty_sector[512];
 static char *empty_sector_1mb;
@@ -517,6 +541,350 @@ hdd_image_gen_vft(int id, vhd_footer_t **vft, uint64_t full_size)
 }
 
 
+/* Open a compressed image, creating it if it doesn't exist yet. */
+static int
+hdd_image_load_hdz(int id)
+{
+    wchar_t *fn = hdd[id].fn;
+    uint32_t spt, hpc, tracks;
+    uint64_t full_size;
+    FILE *f;
+
+    f = plat_fopen(fn, L"rb");
+    if (f != NULL)
+	fclose(f);
+    else if (hdd[id].wp) {
+	hdd_image_log("A write-protected image must exist\n");
+	memset(hdd[id].fn, 0, sizeof(hdd[id].fn));
+	return 0;
+    } else {
+	full_size = ((uint64_t) hdd[id].spt) *
+		    ((uint64_t) hdd[id].hpc) *
+		    ((uint64_t) hdd[id].tracks);
+	if ((full_size == 0) || !hdz_create(fn, full_size, hdd[id].spt, hdd[id].hpc, hdd[id].tracks)) {
+		hdd_image_log("Unable to create image\n");
+		memset(hdd[id].fn, 0, sizeof(hdd[id].fn));
+		return 0;
+	}
+    }
+
+    hdd_images[id].hdz = hdz_open(fn, hdd[id].wp);
+    if (hdd_images[id].hdz == NULL) {
+	hdd_image_log("HDZ: Unable to open image\n");
+	memset(hdd[id].fn, 0, sizeof(hdd[id].fn));
+	return 0;
+    }
+
+    hdz_get_geometry(hdd_images[id].hdz, &spt, &hpc, &tracks);
+    hdd[id].spt = spt;
+    hdd[id].hpc = hpc;
+    hdd[id].tracks = tracks;
+    hdd_images[id].type = 4;
+    hdd_images[id].last_sector = (uint32_t) hdz_get_sectors(hdd_images[id].hdz) - 1;
+    hdd_images[id].loaded = 1;
+
+    return 1;
+}
+
+
+/* Write-back cache.
+
+   Writes are kept in memory, in blocks of 64 sectors with a bit for
+   each sector that holds data, until the guest flushes its cache (or
+   never, in unsafe mode), the cache fills up, or the image is closed.
+   They then go out sorted, with adjacent dirty sectors coalesced into
+   a single write. Reads look in the cache after reading the file. */
+static uint8_t *
+hdd_wbc_data(hdd_image_t *img, hdd_wbc_t *e)
+{
+    return img->wbc_data + ((size_t) e->idx << (HDD_WBC_SHIFT + 9));
+}
+
+
+static uint64_t
+hdd_wbc_mask(uint32_t off, uint32_t n)
+{
+    if (n == HDD_WBC_SECTORS)
+	return ~0ULL;
+
+    return ((1ULL << n) - 1ULL) << off;
+}
+
+
+static hdd_wbc_t *
+hdd_wbc_get(hdd_image_t *img, uint32_t block, int create)
+{
+    uint32_t i = (block * 2654435761U) & (HDD_WBC_SLOTS - 1);
+
+    /* There are twice as many slots as blocks, so this always ends. */
+    while (img->wbc[i].tag != 0) {
+	if (img->wbc[i].tag == (block + 1))
+		return &img->wbc[i];
+	i = (i + 1) & (HDD_WBC_SLOTS - 1);
+    }
+
+    if (!create || (img->wbc_used == HDD_WBC_BLOCKS))
+	return NULL;
+
+    img->wbc[i].tag = block + 1;
+    img->wbc[i].idx = img->wbc_used++;
+    img->wbc[i].dirty = 0ULL;
+
+    return &img->wbc[i];
+}
+
+
+static int
+hdd_wbc_cmp(const void *a, const void *b)
+{
+    const hdd_wbc_t *x = *(const hdd_wbc_t **) a;
+    const hdd_wbc_t *y = *(const hdd_wbc_t **) b;
+
+    if (x->tag != y->tag)
+	return (x->tag < y->tag) ? -1 : 1;
+
+    return 0;
+}
+
+
+static int
+hdd_wbc_idx_cmp(const void *a, const void *b)
+{
+    const hdd_wbc_t *x = (const hdd_wbc_t *) a;
+    const hdd_wbc_t *y = (const hdd_wbc_t *) b;
+
+    if (x->idx != y->idx)
+	return (x->idx < y->idx) ? -1 : 1;
+
+    return 0;
+}
+
+
+/* Drop the blocks with nothing left to write, moving the data of the
+   others down to the start of the pool. */
+static void
+hdd_wbc_compact(hdd_image_t *img)
+{
+    hdd_wbc_t keep[HDD_WBC_BLOCKS], *e;
+    int i, n = 0;
+
+    for (i = 0; i < HDD_WBC_SLOTS; i++) {
+	if ((img->wbc[i].tag != 0) && (img->wbc[i].dirty != 0ULL))
+		keep[n++] = img->wbc[i];
+    }
+
+    /* In pool order, so no block is moved over one not yet moved. */
+    qsort(keep, n, sizeof(hdd_wbc_t), hdd_wbc_idx_cmp);
+
+    memset(img->wbc, 0x00, HDD_WBC_SLOTS * sizeof(hdd_wbc_t));
+    img->wbc_used = 0;
+
+    for (i = 0; i < n; i++) {
+	e = hdd_wbc_get(img, keep[i].tag - 1, 1);
+	if (e->idx != keep[i].idx)
+		memmove(hdd_wbc_data(img, e), hdd_wbc_data(img, &keep[i]), HDD_WBC_SECTORS << 9);
+	e->dirty = keep[i].dirty;
+    }
+}
+
+
+/* Write all dirty sectors out and empty the cache. Sectors that could
+   not be written stay in it. Returns the number of bytes written, or
+   -1 on error. */
+static int64_t
+hdd_wbc_write_back(uint8_t id)
+{
+    hdd_image_t *img = &hdd_images[id];
+    hdd_wbc_t *list[HDD_WBC_BLOCKS];
+    uint32_t sector, next = 0;
+    int64_t written = 0;
+    int i, n = 0, b, e, error = 0, seek = 1;
+
+    for (i = 0; i < HDD_WBC_SLOTS; i++) {
+	if ((img->wbc[i].tag != 0) && (img->wbc[i].dirty != 0ULL))
+		list[n++] = &img->wbc[i];
+    }
+
+    qsort(list, n, sizeof(hdd_wbc_t *), hdd_wbc_cmp);
+
+    for (i = 0; i < n; i++) {
+	for (b = 0; b < HDD_WBC_SECTORS; b = e) {
+		if (!(list[i]->dirty & (1ULL << b))) {
+			e = b + 1;
+			continue;
+		}
+		for (e = b + 1; (e < HDD_WBC_SECTORS) && (list[i]->dirty & (1ULL << e)); e++)
+			;
+
+		/* A run carrying on from the previous one needs no seek,
+		   so stdio hands the whole thing to the OS at once. */
+		sector = ((list[i]->tag - 1) << HDD_WBC_SHIFT) + b;
+		if (seek || (sector != next))
+			fseeko64(img->file, ((uint64_t)(sector) << 9LL) + img->base, SEEK_SET);
+		if (fwrite(hdd_wbc_data(img, list[i]) + (b << 9), 512, e - b, img->file) != (e - b)) {
+			hdd_image_log("HDD image %i: write back of sectors %u-%u failed\n",
+				      id, sector, sector + (e - b) - 1);
+			error = 1;
+			seek = 1;
+			continue;
+		}
+		list[i]->dirty &= ~hdd_wbc_mask(b, e - b);
+		seek = 0;
+		next = sector + (e - b);
+		written += (e - b) << 9;
+	}
+    }
+
+    hdd_wbc_compact(img);
+
+    return error ? -1 : written;
+}
+
+
+static int
+hdd_wbc_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_image_t *img = &hdd_images[id];
+    hdd_wbc_t *e;
+    uint32_t off, n;
+    int ret = 1;
+
+    while (count > 0) {
+	off = sector & (HDD_WBC_SECTORS - 1);
+	n = MIN(count, HDD_WBC_SECTORS - off);
+
+	e = hdd_wbc_get(img, sector >> HDD_WBC_SHIFT, 1);
+	if (e == NULL) {
+		/* Full, so write everything back and start over. */
+		if (hdd_wbc_write_back(id) < 0)
+			ret = 0;
+		e = hdd_wbc_get(img, sector >> HDD_WBC_SHIFT, 1);
+	}
+
+	if (e == NULL) {
+		/* Still full of what could not be written back, so this
+		   goes straight to the file; it is not in the cache. */
+		fseeko64(img->file, ((uint64_t)(sector) << 9LL) + img->base, SEEK_SET);
+		if (fwrite(buffer, 512, n, img->file) != n)
+			ret = 0;
+	} else {
+		memcpy(hdd_wbc_data(img, e) + (off << 9), buffer, n << 9);
+		e->dirty |= hdd_wbc_mask(off, n);
+	}
+
+	buffer += (n << 9);
+	sector += n;
+	count -= n;
+    }
+
+    return ret;
+}
+
+
+/* Lay any cached sectors over what was just read from the file. */
+static void
+hdd_wbc_read(hdd_image_t *img, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_wbc_t *e;
+    uint32_t off, n, i;
+
+    while (count > 0) {
+	off = sector & (HDD_WBC_SECTORS - 1);
+	n = MIN(count, HDD_WBC_SECTORS - off);
+
+	e = hdd_wbc_get(img, sector >> HDD_WBC_SHIFT, 0);
+	if ((e != NULL) && (e->dirty & hdd_wbc_mask(off, n))) {
+		for (i = 0; i < n; i++) {
+			if (e->dirty & (1ULL << (off + i)))
+				memcpy(buffer + (i << 9), hdd_wbc_data(img, e) + ((off + i) << 9), 512);
+		}
+	}
+
+	buffer += (n << 9);
+	sector += n;
+	count -= n;
+    }
+}
+
+
+/* Forget cached sectors that are about to be overwritten in the file. */
+static void
+hdd_wbc_discard(hdd_image_t *img, uint32_t sector, uint32_t count)
+{
+    hdd_wbc_t *e;
+    uint32_t off, n;
+
+    while (count > 0) {
+	off = sector & (HDD_WBC_SECTORS - 1);
+	n = MIN(count, HDD_WBC_SECTORS - off);
+
+	e = hdd_wbc_get(img, sector >> HDD_WBC_SHIFT, 0);
+	if (e != NULL)
+		e->dirty &= ~hdd_wbc_mask(off, n);
+
+	sector += n;
+	count -= n;
+    }
+}
+
+
+/* Raw images get the cache if the guest knows to flush it; compressed
+   images have their own, and shared ones must be written through. */
+static int
+hdd_wbc_enabled(uint8_t id)
+{
+    hdd_image_t *img = &hdd_images[id];
+
+    if (!hdd_image_get_write_cache(id) || (img->file == NULL) ||
+	(img->hdz != NULL) || (img->shm != NULL))
+	return 0;
+
+    if (img->wbc == NULL) {
+	img->wbc = (hdd_wbc_t *) calloc(HDD_WBC_SLOTS, sizeof(hdd_wbc_t));
+	img->wbc_data = (uint8_t *) malloc((size_t) HDD_WBC_BLOCKS << (HDD_WBC_SHIFT + 9));
+	img->wbc_used = 0;
+	if ((img->wbc == NULL) || (img->wbc_data == NULL)) {
+		free(img->wbc);
+		free(img->wbc_data);
+		img->wbc = NULL;
+		img->wbc_data = NULL;
+		return 0;
+	}
+    }
+
+    return 1;
+}
+
+
+static void
+hdd_wbc_close(uint8_t id)
+{
+    hdd_image_t *img = &hdd_images[id];
+
+    if (img->wbc == NULL)
+	return;
+
+    /* Whatever fails here is lost; the image is going away. */
+    if (img->wbc_used && (img->file != NULL))
+	hdd_wbc_write_back(id);
+
+    free(img->wbc);
+    free(img->wbc_data);
+    img->wbc = NULL;
+    img->wbc_data = NULL;
+    img->wbc_used = 0;
+}
+
+
+/* Read-only images may share a block cache with other instances. */
+static void
+hdd_image_share(int id)
+{
+    if (hdd[id].wp && (hdd_images[id].file != NULL))
+	hdd_images[id].shm = disk_shm_open(hdd[id].fn);
+}
+
+
 int
 hdd_image_load(int id)
 {
@@ -535,14 +903,25 @@ hdd_image_load(int id)
     memset(empty_sector, 0, sizeof(empty_sector));
 
     hdd_images[id].base = 0;
+    hdd_images[id].wc_avail = 0;
+    hdd_images[id].wc_off = 0;
 
     if (hdd_images[id].loaded) {
+	hdd_wbc_close(id);
 	if (hdd_images[id].file) {
 		fclose(hdd_images[id].file);
 		hdd_images[id].file = NULL;
 	}
+	if (hdd_images[id].hdz) {
+		hdz_close(hdd_images[id].hdz);
+		hdd_images[id].hdz = NULL;
+	}
 	hdd_images[id].loaded = 0;
     }
+    if (hdd_images[id].shm) {
+	disk_shm_close(hdd_images[id].shm);
+	hdd_images[id].shm = NULL;
+    }
 
     is_hdx[0] = image_is_hdx(fn, 0);
     is_hdx[1] = image_is_hdx(fn, 1);
@@ -558,6 +937,8 @@ hdd_image_load(int id)
 	memset(hdd[id].fn, 0, sizeof(hdd[id].fn));
 	return 0;
     }
+    if (image_is_hdz(fn, 0))
+	return hdd_image_load_hdz(id);
     hdd_images[id].file = plat_fopen(fn, L"rb+");
     if (hdd_images[id].file == NULL) {
 	/* Failed to open existing hard disk image */
@@ -702,6 +1083,7 @@ hdd_image_load(int id)
 		   are there. */
 		hdd_images[id].last_sector = (uint32_t) (full_size >> 9) - 1;
 		hdd_images[id].loaded = 1;
+		hdd_image_share(id);
 		return 1;
 	} else {
 		full_size = ((uint64_t) hdd[id].spt) *
@@ -730,6 +1112,9 @@ hdd_image_load(int id)
 	}
     }
 
+    if (ret && hdd_images[id].loaded)
+	hdd_image_share(id);
+
     return ret;
 }
 
@@ -741,6 +1126,8 @@ hdd_image_seek(uint8_t id, uint32_t sector)
     addr = (uint64_t)sector << 9LL;
 
     hdd_images[id].pos = sector;
+    if (hdd_images[id].hdz != NULL)
+	return;
     fseeko64(hdd_images[id].file, addr + hdd_images[id].base, SEEK_SET);
 }
 
@@ -748,23 +1135,51 @@ hdd_image_seek(uint8_t id, uint32_t sector)
 void
 hdd_image_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 {
-    int i;
+    uint64_t start = disk_trace_start();
+    int i, error = 0;
+
+    if (hdd_images[id].hdz != NULL) {
+	hdd_images[id].pos = sector + count - 1;
+	error = !hdz_read(hdd_images[id].hdz, sector, count, buffer);
+	disk_trace_end(DTRACE_HDD, id, DTRACE_READ, count << 9, start, error);
+	return;
+    }
+
+    if (hdd_images[id].shm != NULL) {
+	hdd_images[id].pos = sector + count - 1;
+	error = (disk_shm_read(hdd_images[id].shm, hdd_images[id].file, buffer,
+			       ((uint64_t)(sector) << 9LL) + hdd_images[id].base,
+			       count << 9) != (count << 9));
+	disk_trace_end(DTRACE_HDD, id, DTRACE_READ, count << 9, start, error);
+	return;
+    }
 
     fseeko64(hdd_images[id].file, ((uint64_t)(sector) << 9LL) + hdd_images[id].base, SEEK_SET);
 
     for (i = 0; i < count; i++) {
-	if (feof(hdd_images[id].file))
+	if (feof(hdd_images[id].file)) {
+		error = 1;
 		break;
+	}
 
 	hdd_images[id].pos = sector + i;
-	fread(buffer + (i << 9), 1, 512, hdd_images[id].file);
+	if (fread(buffer + (i << 9), 1, 512, hdd_images[id].file) != 512)
+		error = 1;
     }
+
+    if (hdd_images[id].wbc_used)
+	hdd_wbc_read(&hdd_images[id], sector, count, buffer);
+
+    disk_trace_end(DTRACE_HDD, id, DTRACE_READ, count << 9, start, error);
 }
 
 
 uint32_t
 hdd_sectors(uint8_t id)
 {
+    if (hdd_images[id].hdz != NULL)
+	return (uint32_t) hdz_get_sectors(hdd_images[id].hdz);
+
     fseeko64(hdd_images[id].file, 0, SEEK_END);
     return (uint32_t) ((ftello64(hdd_images[id].file) - hdd_images[id].base) >> 9);
 }
@@ -790,17 +1205,44 @@ hdd_image_read_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 void
 hdd_image_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 {
-    int i;
+    uint64_t start = disk_trace_start();
+    int i, error = 0;
+
+    if (hdd_images[id].hdz != NULL) {
+	hdd_images[id].pos = sector + count - 1;
+	error = !hdz_write(hdd_images[id].hdz, sector, count, buffer);
+	disk_trace_end(DTRACE_HDD, id, DTRACE_WRITE, count << 9, start, error);
+	return;
+    }
+
+    if (hdd_wbc_enabled(id)) {
+	hdd_images[id].pos = sector + count - 1;
+	error = !hdd_wbc_write(id, sector, count, buffer);
+	disk_trace_end(DTRACE_HDD, id, DTRACE_WRITE, count << 9, start, error);
+	return;
+    }
 
     fseeko64(hdd_images[id].file, ((uint64_t)(sector) << 9LL) + hdd_images[id].base, SEEK_SET);
 
     for (i = 0; i < count; i++) {
-	if (feof(hdd_images[id].file))
+	if (feof(hdd_images[id].file)) {
+		error = 1;
 		break;
+	}
 
 	hdd_images[id].pos = sector + i;
-	fwrite(buffer + (i << 9), 512, 1, hdd_images[id].file);
+	if (fwrite(buffer + (i << 9), 512, 1, hdd_images[id].file) != 1)
+		error = 1;
     }
+
+    if (hdd_images[id].shm != NULL) {
+	/* Other instances must see this before they can miss on it. */
+	fflush(hdd_images[id].file);
+	disk_shm_invalidate(hdd_images[id].shm, ((uint64_t)(sector) << 9LL) + hdd_images[id].base,
+			    count << 9);
+    }
+
+    disk_trace_end(DTRACE_HDD, id, DTRACE_WRITE, count << 9, start, error);
 }
 
 
@@ -824,7 +1266,19 @@ hdd_image_write_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 void
 hdd_image_zero(uint8_t id, uint32_t sector, uint32_t count)
 {
+    uint64_t start = disk_trace_start();
     uint32_t i = 0;
+    int error = 0;
+
+    if (hdd_images[id].hdz != NULL) {
+	hdd_images[id].pos = sector + count - 1;
+	error = !hdz_write(hdd_images[id].hdz, sector, count, NULL);
+	disk_trace_end(DTRACE_HDD, id, DTRACE_ZERO, count << 9, start, error);
+	return;
+    }
+
+    if (hdd_images[id].wbc_used)
+	hdd_wbc_discard(&hdd_images[id], sector, count);
 
     memset(empty_sector, 0, 512);
 
@@ -835,8 +1289,18 @@ hdd_image_zero(uint8_t id, uint32_t sector, uint32_t count)
 		break;
 
 	hdd_images[id].pos = sector + i;
-	fwrite(empty_sector, 512, 1, hdd_images[id].file);
+	if (fwrite(empty_sector, 512, 1, hdd_images[id].file) != 1)
+		error = 1;
     }
+
+    if (hdd_images[id].shm != NULL) {
+	/* Other instances must see this before they can miss on it. */
+	fflush(hdd_images[id].file);
+	disk_shm_invalidate(hdd_images[id].shm, ((uint64_t)(sector) << 9LL) + hdd_images[id].base,
+			    count << 9);
+    }
+
+    disk_trace_end(DTRACE_HDD, id, DTRACE_ZERO, count << 9, start, error);
 }
 
 
@@ -857,6 +1321,94 @@ hdd_image_zero_ex(uint8_t id, uint32_t sector, uint32_t count)
 }
 
 
+/* The guest asked for its writes to be made permanent. Returns 0 if
+   some of them could not be. */
+int
+hdd_image_flush(uint8_t id)
+{
+    uint64_t start;
+    int64_t written = 0;
+    int error = 0;
+
+    /* Throwaway machines don't care whether the data made it. */
+    if (!hdd_images[id].loaded || (hdd_cache_mode == HDD_CACHE_UNSAFE))
+	return 1;
+
+    start = disk_trace_start();
+
+    if (hdd_images[id].hdz != NULL)
+	error = !hdz_flush(hdd_images[id].hdz);
+    else if (hdd_images[id].file != NULL) {
+	if (hdd_images[id].wbc_used) {
+		written = hdd_wbc_write_back(id);
+		if (written < 0) {
+			written = 0;
+			error = 1;
+		}
+	}
+	if (fflush(hdd_images[id].file) != 0)
+		error = 1;
+    }
+
+    disk_trace_end(DTRACE_HDD, id, DTRACE_FLUSH, (uint32_t) written, start, error);
+
+    return !error;
+}
+
+
+/* Whether writes to the drive may be held back until a flush. */
+int
+hdd_image_get_write_cache(uint8_t id)
+{
+    return (hdd_cache_mode != HDD_CACHE_WRITETHROUGH) && hdd_images[id].wc_avail &&
+	   !hdd_images[id].wc_off;
+}
+
+
+/* The controller tells the guest about the drive's write cache, and
+   implements the command to flush it. Until then, writes go straight
+   through, as the guest has no reason to flush. */
+void
+hdd_image_report_write_cache(uint8_t id, int report)
+{
+    hdd_images[id].wc_avail = !!report;
+
+    if (!report)
+	hdd_wbc_close(id);
+}
+
+
+/* The guest turned the drive's write cache on or off; once off, what
+   it had cached goes out and every write after goes straight through.
+   Returns 0, leaving the cache on, if what it had cannot be written. */
+int
+hdd_image_set_write_cache(uint8_t id, int enable)
+{
+    hdd_image_t *img = &hdd_images[id];
+
+    if (enable || !img->loaded) {
+	img->wc_off = !enable;
+	return 1;
+    }
+
+    if (img->wbc_used && (hdd_wbc_write_back(id) < 0))
+	return 0;
+    hdd_wbc_close(id);
+
+    if (img->hdz != NULL) {
+	if (! hdz_flush(img->hdz))
+		return 0;
+    } else if (img->file != NULL) {
+	if (fflush(img->file) != 0)
+		return 0;
+    }
+
+    img->wc_off = 1;
+
+    return 1;
+}
+
+
 uint32_t
 hdd_image_get_last_sector(uint8_t id)
 {
@@ -885,10 +1437,19 @@ hdd_image_unload(uint8_t id, int fn_preserve)
 	return;
 
     if (hdd_images[id].loaded) {
+	hdd_wbc_close(id);
 	if (hdd_images[id].file != NULL) {
 		fclose(hdd_images[id].file);
 		hdd_images[id].file = NULL;
 	}
+	if (hdd_images[id].hdz != NULL) {
+		hdz_close(hdd_images[id].hdz);
+		hdd_images[id].hdz = NULL;
+	}
+	if (hdd_images[id].shm != NULL) {
+		disk_shm_close(hdd_images[id].shm);
+		hdd_images[id].shm = NULL;
+	}
 	hdd_images[id].loaded = 0;
     }
 
@@ -909,10 +1470,19 @@ hdd_image_close(uint8_t id)
     if (!hdd_images[id].loaded)
 	return;
 
+    hdd_wbc_close(id);
     if (hdd_images[id].file != NULL) {
 	fclose(hdd_images[id].file);
 	hdd_images[id].file = NULL;
     }
+    if (hdd_images[id].hdz != NULL) {
+	hdz_close(hdd_images[id].hdz);
+	hdd_images[id].hdz = NULL;
+    }
+    if (hdd_images[id].shm != NULL) {
+	disk_shm_close(hdd_images[id].shm);
+	hdd_images[id].shm = NULL;
+    }
     memset(&hdd_images[id], 0, sizeof(hdd_image_t));
     hdd_images[id].loaded = 0;
 }
@@ -0,0 +1,902 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		Compressed hard disk image files (.HDZ).
+ *
+ *		The disk is cut into 64 KB blocks, each compressed on its
+ *		own with LZF (or stored as is if that doesn't help). Blocks
+ *		that are all zeros take no space at all, so a new image is
+ *		just the header and an empty index, and blocks with the
+ *		same contents share one copy in the file. Every index entry
+ *		carries a hash of its block, which is what finds those
+ *		copies, and lets tools match blocks across images.
+ *
+ *		Decompressed blocks are kept in a small LRU cache per image.
+ *		Writes go to the cached block, which is compressed and put
+ *		back in the file when it leaves the cache or the image is
+ *		closed. Space freed by a rewritten block is reused for later
+ *		ones; the file itself never shrinks, converting the image
+ *		again packs it.
+ *
+ *		File layout (little endian):
+ *
+ *		  header	hdz_header_t, geometry at the same
+ *				offsets as in an .HDX file
+ *		  index		hdz_entry_t[blocks]
+ *		  data		compressed blocks
+ *
+ * Version:	@(#)hdd_image_hdz.c	1.0.0	2020/01/28
+ */
+#define _LARGEFILE_SOURCE
+#define _LARGEFILE64_SOURCE
+#define __STDC_FORMAT_MACROS
+#include <stdarg.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include "../86box.h"
+#include "../plat.h"
+#include "../floppy/lzf/lzf.h"
+#include "hdd.h"
+
+
+#define HDZ_MAGIC	"86BoxHDZ"
+#define HDZ_VERSION	1
+
+#define HDZ_BLOCK	65536
+#define HDZ_BLOCK_SECTORS	(HDZ_BLOCK >> 9)
+
+#define HDZ_STORED	0x0001			/* block is not compressed */
+
+#define HDZ_CACHE	32			/* blocks in the cache */
+
+
+#pragma pack(push,1)
+typedef struct {
+    char	magic[8];
+    uint64_t	sectors;
+    uint32_t	sector_size,
+		spt, hpc, tracks,
+		version,
+		block_size,
+		blocks,
+		flags;
+} hdz_header_t;
+
+typedef struct {
+    uint64_t	offset,
+		hash;
+    uint32_t	size,				/* 0 if the block is all zeros */
+		flags;
+} hdz_entry_t;
+#pragma pack(pop)
+
+typedef struct {
+    uint64_t	offset;
+    uint32_t	size;
+} hdz_extent_t;
+
+typedef struct {
+    uint32_t	block,
+		used;
+    int		dirty;
+    uint8_t	*data;
+} hdz_block_t;
+
+typedef struct {
+    FILE	*f;
+    int		read_only;
+    hdz_header_t hdr;
+    hdz_entry_t	*index;
+
+    uint32_t	*bucket,			/* hash chains, block + 1 */
+		*next,
+		mask;
+    uint64_t	end;				/* end of the used space */
+
+    hdz_extent_t *holes;			/* free space before end */
+    int		nholes, maxholes;
+
+    hdz_block_t	cache[HDZ_CACHE];
+    uint32_t	tick;
+
+    uint32_t	zero, dupes;			/* for the converter */
+
+    uint8_t	*cbuf,				/* compressed block */
+		*tbuf;				/* block being compared */
+} hdz_t;
+
+
+#ifdef ENABLE_HDD_IMAGE_HDZ_LOG
+int hdd_image_hdz_do_log = ENABLE_HDD_IMAGE_HDZ_LOG;
+
+
+static void
+hdz_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (hdd_image_hdz_do_log) {
+	va_start(ap, fmt);
+	pclog_ex(fmt, ap);
+	va_end(ap);
+    }
+}
+#else
+#define hdz_log(fmt, ...)
+#endif
+
+
+static int
+hdz_is_zero(const uint8_t *data)
+{
+    const uint64_t *p = (const uint64_t *) data;
+    int i;
+
+    for (i = 0; i < (HDZ_BLOCK / 8); i++) {
+	if (p[i])
+		return(0);
+    }
+
+    return(1);
+}
+
+
+/* 64-bit FNV-1a, a word at a time. */
+static uint64_t
+hdz_hash(const uint8_t *data)
+{
+    const uint64_t *p = (const uint64_t *) data;
+    uint64_t h = 0xcbf29ce484222325ull;
+    int i;
+
+    for (i = 0; i < (HDZ_BLOCK / 8); i++)
+	h = (h ^ p[i]) * 0x100000001b3ull;
+
+    return(h);
+}
+
+
+static void
+hdz_chain_add(hdz_t *hdz, uint32_t block)
+{
+    uint32_t *b = &hdz->bucket[hdz->index[block].hash & hdz->mask];
+
+    hdz->next[block] = *b;
+    *b = block + 1;
+}
+
+
+static void
+hdz_chain_remove(hdz_t *hdz, uint32_t block)
+{
+    uint32_t *b = &hdz->bucket[hdz->index[block].hash & hdz->mask];
+
+    while (*b) {
+	if (*b == (block + 1)) {
+		*b = hdz->next[block];
+		break;
+	}
+	b = &hdz->next[*b - 1];
+    }
+}
+
+
+/* Give space back, merging it with the holes next to it. */
+static void
+hdz_free(hdz_t *hdz, uint64_t offset, uint32_t size)
+{
+    hdz_extent_t *h;
+    int i;
+
+    for (i = 0; (i < hdz->nholes) && (hdz->holes[i].offset < offset); i++)
+	;
+
+    if ((i > 0) && ((hdz->holes[i - 1].offset + hdz->holes[i - 1].size) == offset)) {
+	/* Grow the one before. */
+	i--;
+	hdz->holes[i].size += size;
+    } else {
+	if (hdz->nholes == hdz->maxholes) {
+		h = (hdz_extent_t *) realloc(hdz->holes, (hdz->maxholes + 64) * sizeof(hdz_extent_t));
+		if (h == NULL)
+			return;		/* just leak it */
+		hdz->holes = h;
+		hdz->maxholes += 64;
+	}
+	memmove(&hdz->holes[i + 1], &hdz->holes[i], (hdz->nholes - i) * sizeof(hdz_extent_t));
+	hdz->holes[i].offset = offset;
+	hdz->holes[i].size = size;
+	hdz->nholes++;
+    }
+
+    /* And the one after. */
+    if ((i + 1) < hdz->nholes) {
+	h = &hdz->holes[i];
+	if ((h->offset + h->size) == h[1].offset) {
+		h->size += h[1].size;
+		hdz->nholes--;
+		memmove(&h[1], &h[2], (hdz->nholes - i - 1) * sizeof(hdz_extent_t));
+	}
+    }
+
+    /* A hole at the end is just unused space. */
+    h = &hdz->holes[hdz->nholes - 1];
+    if ((h->offset + h->size) == hdz->end) {
+	hdz->end = h->offset;
+	hdz->nholes--;
+    }
+}
+
+
+/* Find room for a block, in the first hole it fits in. */
+static uint64_t
+hdz_alloc(hdz_t *hdz, uint32_t size)
+{
+    uint64_t offset;
+    int i;
+
+    for (i = 0; i < hdz->nholes; i++) {
+	if (hdz->holes[i].size < size)
+		continue;
+
+	offset = hdz->holes[i].offset;
+	hdz->holes[i].offset += size;
+	hdz->holes[i].size -= size;
+	if (hdz->holes[i].size == 0) {
+		hdz->nholes--;
+		memmove(&hdz->holes[i], &hdz->holes[i + 1], (hdz->nholes - i) * sizeof(hdz_extent_t));
+	}
+	return(offset);
+    }
+
+    offset = hdz->end;
+    hdz->end += size;
+
+    return(offset);
+}
+
+
+/* Read a block as it is in the file. */
+static int
+hdz_load(hdz_t *hdz, uint32_t block, uint8_t *data)
+{
+    hdz_entry_t *e = &hdz->index[block];
+
+    if (e->size == 0) {
+	memset(data, 0x00, HDZ_BLOCK);
+	return(1);
+    }
+
+    if (e->size > HDZ_BLOCK)
+	return(0);
+
+    fseeko64(hdz->f, e->offset, SEEK_SET);
+    if (e->flags & HDZ_STORED) {
+	if (fread(data, 1, e->size, hdz->f) != e->size)
+		return(0);
+    } else {
+	if (fread(hdz->cbuf, 1, e->size, hdz->f) != e->size)
+		return(0);
+	if (lzf_decompress(hdz->cbuf, e->size, data, HDZ_BLOCK) != HDZ_BLOCK) {
+		hdz_log("HDZ: block %u is corrupt\n", block);
+		return(0);
+	}
+    }
+
+    return(1);
+}
+
+
+/* Put a block's new contents in the file.
+
+   The new data goes to space of its own and the index entry is only
+   pointed at it once that worked, so a failed write leaves the block as
+   it was. The old data is freed last. */
+static int
+hdz_store(hdz_t *hdz, uint32_t block, uint8_t *data)
+{
+    hdz_entry_t *e = &hdz->index[block];
+    hdz_entry_t old = *e, ne;
+    uint32_t c, clen;
+    int alloced = 0, dupe = 0;
+
+    memset(&ne, 0x00, sizeof(hdz_entry_t));
+
+    if (! hdz_is_zero(data)) {
+	ne.hash = hdz_hash(data);
+
+	/* Share the data of a block with the same contents. */
+	for (c = hdz->bucket[ne.hash & hdz->mask]; c; c = hdz->next[c - 1]) {
+		if ((hdz->index[c - 1].hash != ne.hash) || (hdz->index[c - 1].size == 0))
+			continue;
+		if (hdz_load(hdz, c - 1, hdz->tbuf) && !memcmp(hdz->tbuf, data, HDZ_BLOCK)) {
+			ne.offset = hdz->index[c - 1].offset;
+			ne.size = hdz->index[c - 1].size;
+			ne.flags = hdz->index[c - 1].flags;
+			dupe = 1;
+			break;
+		}
+	}
+
+	if (ne.size == 0) {
+		clen = lzf_compress(data, HDZ_BLOCK, hdz->cbuf, HDZ_BLOCK - 1);
+		if (clen == 0) {
+			ne.size = HDZ_BLOCK;
+			ne.flags = HDZ_STORED;
+		} else
+			ne.size = clen;
+		ne.offset = hdz_alloc(hdz, ne.size);
+		alloced = 1;
+
+		fseeko64(hdz->f, ne.offset, SEEK_SET);
+		if (fwrite((ne.flags & HDZ_STORED) ? data : hdz->cbuf, 1, ne.size, hdz->f) != ne.size)
+			goto fail;
+	}
+    }
+
+    fseeko64(hdz->f, sizeof(hdz_header_t) + ((uint64_t) block * sizeof(hdz_entry_t)), SEEK_SET);
+    if (fwrite(&ne, 1, sizeof(hdz_entry_t), hdz->f) != sizeof(hdz_entry_t))
+	goto fail;
+
+    if (old.size != 0)
+	hdz_chain_remove(hdz, block);
+    *e = ne;
+    if (ne.size != 0)
+	hdz_chain_add(hdz, block);
+
+    if (ne.size == 0)
+	hdz->zero++;
+    else if (dupe)
+	hdz->dupes++;
+
+    /* Free the old data, unless a block still uses it. */
+    if (old.size != 0) {
+	for (c = hdz->bucket[old.hash & hdz->mask]; c; c = hdz->next[c - 1]) {
+		if ((hdz->index[c - 1].size != 0) && (hdz->index[c - 1].offset == old.offset))
+			break;
+	}
+	if (c == 0)
+		hdz_free(hdz, old.offset, old.size);
+    }
+
+    return(1);
+
+fail:
+    hdz_log("HDZ: write error on block %u\n", block);
+
+    /* The entry in the file may be half written, put the old one back. */
+    fseeko64(hdz->f, sizeof(hdz_header_t) + ((uint64_t) block * sizeof(hdz_entry_t)), SEEK_SET);
+    fwrite(&old, 1, sizeof(hdz_entry_t), hdz->f);
+
+    if (alloced)
+	hdz_free(hdz, ne.offset, ne.size);
+
+    return(0);
+}
+
+
+static hdz_block_t *
+hdz_cache_find(hdz_t *hdz, uint32_t block)
+{
+    int i;
+
+    for (i = 0; i < HDZ_CACHE; i++) {
+	if ((hdz->cache[i].used != 0) && (hdz->cache[i].block == block)) {
+		hdz->cache[i].used = ++hdz->tick;
+		return(&hdz->cache[i]);
+	}
+    }
+
+    return(NULL);
+}
+
+
+/* Get a block into the cache, reading it in unless it is about to be
+   overwritten completely. */
+static hdz_block_t *
+hdz_cache_get(hdz_t *hdz, uint32_t block, int load)
+{
+    hdz_block_t *b;
+    int i;
+
+    b = hdz_cache_find(hdz, block);
+    if (b != NULL)
+	return(b);
+
+    b = &hdz->cache[0];
+    for (i = 1; i < HDZ_CACHE; i++) {
+	if (hdz->cache[i].used < b->used)
+		b = &hdz->cache[i];
+    }
+
+    /* If the block it holds cannot be written out, it has to stay. */
+    if (b->dirty) {
+	if (! hdz_store(hdz, b->block, b->data))
+		return(NULL);
+	b->dirty = 0;
+    }
+    b->used = 0;
+
+    if (load) {
+	if (! hdz_load(hdz, block, b->data))
+		return(NULL);
+    } else
+	memset(b->data, 0x00, HDZ_BLOCK);
+
+    b->block = block;
+    b->used = ++hdz->tick;
+
+    return(b);
+}
+
+
+int
+image_is_hdz(const wchar_t *s, int check_signature)
+{
+    int len;
+    FILE *f;
+    char magic[8];
+    len = wcslen(s);
+    if ((len < 4) || (s[0] == L'.'))
+	return 0;
+    if (wcscasecmp(&s[len - 4], L".HDZ") == 0) {
+	if (check_signature) {
+		f = plat_fopen((wchar_t *)s, L"rb");
+		if (!f)
+			return 0;
+		len = fread(magic, 1, sizeof(magic), f);
+		fclose(f);
+		if ((len == sizeof(magic)) && !memcmp(magic, HDZ_MAGIC, sizeof(magic)))
+			return 1;
+		else
+			return 0;
+	} else
+		return 1;
+    } else
+	return 0;
+}
+
+
+/* Write the header and an index of all-zero blocks. */
+int
+hdz_create(const wchar_t *fn, uint64_t sectors, uint32_t spt, uint32_t hpc, uint32_t tracks)
+{
+    hdz_header_t hdr;
+    hdz_entry_t e;
+    FILE *f;
+    uint32_t i;
+
+    f = plat_fopen64(fn, L"wb");
+    if (f == NULL)
+	return(0);
+
+    memset(&hdr, 0x00, sizeof(hdr));
+    memcpy(hdr.magic, HDZ_MAGIC, sizeof(hdr.magic));
+    hdr.sectors = sectors;
+    hdr.sector_size = 512;
+    hdr.spt = spt;
+    hdr.hpc = hpc;
+    hdr.tracks = tracks;
+    hdr.version = HDZ_VERSION;
+    hdr.block_size = HDZ_BLOCK;
+    hdr.blocks = (uint32_t) ((sectors + HDZ_BLOCK_SECTORS - 1) / HDZ_BLOCK_SECTORS);
+    fwrite(&hdr, 1, sizeof(hdr), f);
+
+    memset(&e, 0x00, sizeof(e));
+    for (i = 0; i < hdr.blocks; i++)
+	fwrite(&e, 1, sizeof(e), f);
+
+    fclose(f);
+
+    return(1);
+}
+
+
+void
+hdz_close(void *p)
+{
+    hdz_t *hdz = (hdz_t *) p;
+    int i;
+
+    if (hdz == NULL)
+	return;
+
+    if (hdz->f != NULL) {
+	if (hdz->index != NULL) {
+		for (i = 0; i < HDZ_CACHE; i++) {
+			if (hdz->cache[i].dirty)
+				hdz_store(hdz, hdz->cache[i].block, hdz->cache[i].data);
+		}
+	}
+	fclose(hdz->f);
+    }
+
+    for (i = 0; i < HDZ_CACHE; i++) {
+	if (hdz->cache[i].data != NULL)
+		free(hdz->cache[i].data);
+    }
+    if (hdz->index != NULL)
+	free(hdz->index);
+    if (hdz->bucket != NULL)
+	free(hdz->bucket);
+    if (hdz->next != NULL)
+	free(hdz->next);
+    if (hdz->holes != NULL)
+	free(hdz->holes);
+    if (hdz->cbuf != NULL)
+	free(hdz->cbuf);
+    if (hdz->tbuf != NULL)
+	free(hdz->tbuf);
+
+    free(hdz);
+}
+
+
+/* Put every changed block back in the file. */
+int
+hdz_flush(void *p)
+{
+    hdz_t *hdz = (hdz_t *) p;
+    int i, ret = 1;
+
+    for (i = 0; i < HDZ_CACHE; i++) {
+	if (hdz->cache[i].dirty) {
+		if (hdz_store(hdz, hdz->cache[i].block, hdz->cache[i].data))
+			hdz->cache[i].dirty = 0;
+		else
+			ret = 0;
+	}
+    }
+
+    if (fflush(hdz->f) != 0)
+	ret = 0;
+
+    return(ret);
+}
+
+
+static int
+hdz_extent_cmp(const void *a, const void *b)
+{
+    const hdz_extent_t *x = (const hdz_extent_t *) a;
+    const hdz_extent_t *y = (const hdz_extent_t *) b;
+
+    if (x->offset != y->offset)
+	return((x->offset < y->offset) ? -1 : 1);
+
+    return(0);
+}
+
+
+void *
+hdz_open(const wchar_t *fn, int read_only)
+{
+    hdz_t *hdz;
+    hdz_entry_t *e;
+    hdz_extent_t *ext;
+    uint32_t i, n;
+
+    hdz = (hdz_t *) malloc(sizeof(hdz_t));
+    if (hdz == NULL)
+	return(NULL);
+    memset(hdz, 0x00, sizeof(hdz_t));
+
+    hdz->read_only = read_only;
+    hdz->f = plat_fopen64(fn, read_only ? L"rb" : L"rb+");
+    if (hdz->f == NULL) {
+	free(hdz);
+	return(NULL);
+    }
+
+    if ((fread(&hdz->hdr, 1, sizeof(hdz_header_t), hdz->f) != sizeof(hdz_header_t)) ||
+	memcmp(hdz->hdr.magic, HDZ_MAGIC, sizeof(hdz->hdr.magic)) ||
+	(hdz->hdr.version != HDZ_VERSION) || (hdz->hdr.block_size != HDZ_BLOCK) ||
+	(hdz->hdr.sector_size != 512) || (hdz->hdr.sectors == 0) ||
+	(hdz->hdr.blocks != ((hdz->hdr.sectors + HDZ_BLOCK_SECTORS - 1) / HDZ_BLOCK_SECTORS))) {
+	hdz_log("HDZ: %ls is not a valid image\n", fn);
+	hdz_close(hdz);
+	return(NULL);
+    }
+
+    /* Hash chains, with about one bucket per block. */
+    for (hdz->mask = 1; hdz->mask < hdz->hdr.blocks; hdz->mask <<= 1)
+	;
+    hdz->bucket = (uint32_t *) malloc(hdz->mask * sizeof(uint32_t));
+    hdz->mask--;
+
+    hdz->index = (hdz_entry_t *) malloc(hdz->hdr.blocks * sizeof(hdz_entry_t));
+    hdz->next = (uint32_t *) malloc(hdz->hdr.blocks * sizeof(uint32_t));
+    hdz->cbuf = (uint8_t *) malloc(HDZ_BLOCK);
+    hdz->tbuf = (uint8_t *) malloc(HDZ_BLOCK);
+    if ((hdz->bucket == NULL) || (hdz->index == NULL) || (hdz->next == NULL) ||
+	(hdz->cbuf == NULL) || (hdz->tbuf == NULL) ||
+	(fread(hdz->index, sizeof(hdz_entry_t), hdz->hdr.blocks, hdz->f) != hdz->hdr.blocks)) {
+	hdz_close(hdz);
+	return(NULL);
+    }
+
+    for (i = 0; i < HDZ_CACHE; i++) {
+	hdz->cache[i].data = (uint8_t *) malloc(HDZ_BLOCK);
+	if (hdz->cache[i].data == NULL) {
+		hdz_close(hdz);
+		return(NULL);
+	}
+    }
+
+    memset(hdz->bucket, 0x00, (hdz->mask + 1) * sizeof(uint32_t));
+    for (i = 0; i < hdz->hdr.blocks; i++) {
+	if (hdz->index[i].size != 0)
+		hdz_chain_add(hdz, i);
+    }
+
+    /* Whatever lies between the blocks in use is free. */
+    ext = (hdz_extent_t *) malloc((hdz->hdr.blocks + 1) * sizeof(hdz_extent_t));
+    if (ext == NULL) {
+	hdz_close(hdz);
+	return(NULL);
+    }
+    for (i = n = 0; i < hdz->hdr.blocks; i++) {
+	e = &hdz->index[i];
+	if (e->size != 0) {
+		ext[n].offset = e->offset;
+		ext[n++].size = e->size;
+	}
+    }
+    qsort(ext, n, sizeof(hdz_extent_t), hdz_extent_cmp);
+    hdz->end = sizeof(hdz_header_t) + ((uint64_t) hdz->hdr.blocks * sizeof(hdz_entry_t));
+    for (i = 0; i < n; i++) {
+	if (ext[i].offset > hdz->end)
+		hdz_free(hdz, hdz->end, (uint32_t) (ext[i].offset - hdz->end));
+	if ((ext[i].offset + ext[i].size) > hdz->end)
+		hdz->end = ext[i].offset + ext[i].size;
+    }
+    free(ext);
+
+    hdz_log("HDZ: opened %ls, %u blocks\n", fn, hdz->hdr.blocks);
+
+    return(hdz);
+}
+
+
+uint64_t
+hdz_get_sectors(void *p)
+{
+    return(((hdz_t *) p)->hdr.sectors);
+}
+
+
+void
+hdz_get_geometry(void *p, uint32_t *spt, uint32_t *hpc, uint32_t *tracks)
+{
+    hdz_t *hdz = (hdz_t *) p;
+
+    *spt = hdz->hdr.spt;
+    *hpc = hdz->hdr.hpc;
+    *tracks = hdz->hdr.tracks;
+}
+
+
+int
+hdz_read(void *p, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdz_t *hdz = (hdz_t *) p;
+    hdz_block_t *b;
+    uint32_t block, off, n;
+
+    if (((uint64_t) sector + count) > hdz->hdr.sectors)
+	return(0);
+
+    while (count > 0) {
+	block = sector / HDZ_BLOCK_SECTORS;
+	off = sector % HDZ_BLOCK_SECTORS;
+	n = HDZ_BLOCK_SECTORS - off;
+	if (n > count)
+		n = count;
+
+	b = hdz_cache_find(hdz, block);
+	if ((b == NULL) && (hdz->index[block].size == 0))
+		memset(buffer, 0x00, n << 9);
+	else {
+		if (b == NULL)
+			b = hdz_cache_get(hdz, block, 1);
+		if (b == NULL)
+			return(0);
+		memcpy(buffer, b->data + (off << 9), n << 9);
+	}
+
+	buffer += (n << 9);
+	sector += n;
+	count -= n;
+    }
+
+    return(1);
+}
+
+
+/* Write sectors, or zero them if buffer is NULL. */
+int
+hdz_write(void *p, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdz_t *hdz = (hdz_t *) p;
+    hdz_block_t *b;
+    uint32_t block, off, n, valid;
+
+    if (hdz->read_only || (((uint64_t) sector + count) > hdz->hdr.sectors))
+	return(0);
+
+    while (count > 0) {
+	block = sector / HDZ_BLOCK_SECTORS;
+	off = sector % HDZ_BLOCK_SECTORS;
+	n = HDZ_BLOCK_SECTORS - off;
+	if (n > count)
+		n = count;
+
+	/* The last block may be cut short by the end of the disk. */
+	valid = HDZ_BLOCK_SECTORS;
+	if (((uint64_t) (block + 1) * HDZ_BLOCK_SECTORS) > hdz->hdr.sectors)
+		valid = (uint32_t) (hdz->hdr.sectors - ((uint64_t) block * HDZ_BLOCK_SECTORS));
+
+	/* Zeroing a block that is zero already changes nothing. */
+	if ((buffer == NULL) && (hdz->index[block].size == 0) &&
+	    (hdz_cache_find(hdz, block) == NULL))
+		b = NULL;
+	else {
+		b = hdz_cache_get(hdz, block, (off != 0) || (n < valid));
+		if (b == NULL)
+			return(0);
+		if (buffer != NULL)
+			memcpy(b->data + (off << 9), buffer, n << 9);
+		else
+			memset(b->data + (off << 9), 0x00, n << 9);
+		b->dirty = 1;
+	}
+
+	if (buffer != NULL)
+		buffer += (n << 9);
+	sector += n;
+	count -= n;
+    }
+
+    return(1);
+}
+
+
+/* Compress a hard disk image (raw, .HDI, .HDX, fixed .VHD or another
+   .HDZ) into a new .HDZ file. Returns 0 on success. */
+int
+hdz_convert(const wchar_t *in, const wchar_t *out)
+{
+    vhd_footer_t *vft = NULL;
+    hdz_t *hdz = NULL;
+    void *src = NULL;
+    FILE *fi = NULL;
+    uint8_t *buf = NULL;
+    uint64_t sectors, base = 0, size, len;
+    uint32_t spt = 0, hpc = 0, tracks = 0, sector_size = 512;
+    uint32_t i, n;
+    int ret = 1;
+
+    if (image_is_hdz(in, 1)) {
+	src = hdz_open(in, 1);
+	if (src == NULL) {
+		printf("Unable to open '%ls'\n", in);
+		return(1);
+	}
+	sectors = hdz_get_sectors(src);
+	hdz_get_geometry(src, &spt, &hpc, &tracks);
+    } else {
+	fi = plat_fopen64(in, L"rb");
+	if (fi == NULL) {
+		printf("Unable to open '%ls'\n", in);
+		return(1);
+	}
+	fseeko64(fi, 0, SEEK_END);
+	size = ftello64(fi);
+
+	if (image_is_hdi(in) || image_is_hdx(in, 1)) {
+		if (image_is_hdi(in)) {
+			fseeko64(fi, 0x08, SEEK_SET);
+			fread(&n, 1, 4, fi);
+			base = n;
+			fread(&n, 1, 4, fi);
+			size = n;
+		} else {
+			base = 0x28;
+			fseeko64(fi, 0x08, SEEK_SET);
+			fread(&size, 1, 8, fi);
+		}
+		fseeko64(fi, 0x10, SEEK_SET);
+		fread(&sector_size, 1, 4, fi);
+		fread(&spt, 1, 4, fi);
+		fread(&hpc, 1, 4, fi);
+		fread(&tracks, 1, 4, fi);
+	} else if (image_is_vhd(in, 1)) {
+		buf = (uint8_t *) malloc(512);
+		fseeko64(fi, -512, SEEK_END);
+		fread(buf, 1, 512, fi);
+		new_vhd_footer(&vft);
+		vhd_footer_from_bytes(vft, buf);
+		if (vft->type != 2) {
+			printf("'%ls' is not a fixed size VHD\n", in);
+			free(vft);
+			goto done;
+		}
+		size = vft->orig_size;
+		tracks = vft->geom.cyl;
+		hpc = vft->geom.heads;
+		spt = vft->geom.spt;
+		free(vft);
+		free(buf);
+		buf = NULL;
+	} else
+		hdd_image_calc_chs(&tracks, &hpc, &spt, (uint32_t) (size >> 20));
+
+	if (sector_size != 512) {
+		printf("'%ls' has a sector size that is not 512\n", in);
+		goto done;
+	}
+	sectors = size >> 9;
+    }
+
+    if ((sectors == 0) || !hdz_create(out, sectors, spt, hpc, tracks) ||
+	((hdz = (hdz_t *) hdz_open(out, 0)) == NULL)) {
+	printf("Unable to create '%ls'\n", out);
+	goto done;
+    }
+
+    buf = (uint8_t *) malloc(HDZ_BLOCK);
+    if (buf == NULL)
+	goto done;
+
+    /* Straight to the file, the cache would only get in the way. */
+    for (i = 0; i < hdz->hdr.blocks; i++) {
+	n = HDZ_BLOCK_SECTORS;
+	if (((uint64_t) (i + 1) * HDZ_BLOCK_SECTORS) > sectors)
+		n = (uint32_t) (sectors - ((uint64_t) i * HDZ_BLOCK_SECTORS));
+
+	memset(buf, 0x00, HDZ_BLOCK);
+	if (src != NULL)
+		len = hdz_read(src, i * HDZ_BLOCK_SECTORS, n, buf) ? n : 0;
+	else {
+		fseeko64(fi, base + ((uint64_t) i * HDZ_BLOCK), SEEK_SET);
+		len = fread(buf, 512, n, fi);
+	}
+	if (len != n) {
+		printf("Read error in '%ls'\n", in);
+		goto done;
+	}
+
+	if (! hdz_store(hdz, i, buf)) {
+		printf("Write error in '%ls'\n", out);
+		goto done;
+	}
+    }
+
+    printf("%ls: %" PRIu64 " sectors in %u blocks (%u zero, %u duplicate), "
+	   "compressed to %" PRIu64 " bytes (%i%%)\n",
+	   out, sectors, hdz->hdr.blocks, hdz->zero, hdz->dupes, hdz->end,
+	   (int) ((hdz->end * 100) / (sectors << 9)));
+    ret = 0;
+
+done:
+    if (hdz != NULL)
+	hdz_close(hdz);
+    if (src != NULL)
+	hdz_close(src);
+    if (fi != NULL)
+	fclose(fi);
+    if (buf != NULL)
+	free(buf);
+
+    return(ret);
+}
@@ -28,6 +28,7 @@
 #include "../timer.h"
 #include "../device.h"
 #include "../piix.h"
+#include "disk_trace.h"
 #include "../scsi/scsi_device.h"
 #include "../nvr.h"
 #include "../plat.h"
@@ -472,9 +473,158 @@ find_zip_for_channel(uint8_t channel)
 }
 
 
+/* Number of bytes of a cache block that lie on the medium. */
+static uint32_t
+zip_cache_block_len(zip_t *dev, uint32_t block)
+{
+    uint32_t first = block << ZIP_CACHE_SHIFT;
+    uint32_t n = 1 << ZIP_CACHE_SHIFT;
+
+    if ((first + n) > dev->drv->medium_size)
+	n = dev->drv->medium_size - first;
+
+    return n << 9;
+}
+
+
+static void
+zip_cache_write_back(zip_t *dev, zip_cache_t *c)
+{
+    uint32_t len;
+    uint64_t start;
+    int error = 0;
+
+    if (c->valid && c->dirty) {
+	start = disk_trace_start();
+	len = zip_cache_block_len(dev, c->block);
+	fseek(dev->drv->f, dev->drv->base + (c->block << (ZIP_CACHE_SHIFT + 9)), SEEK_SET);
+	if (fwrite(c->data, 1, len, dev->drv->f) != len) {
+		zip_log("ZIP %i: Error writing back block %i\n", dev->id, c->block);
+		error = 1;
+	}
+	disk_trace_end(DTRACE_ZIP, dev->id, DTRACE_WRITE, len, start, error);
+	c->dirty = 0;
+    }
+}
+
+
+/* Write back all dirty blocks and, if release is set, drop the cache. */
+static void
+zip_cache_flush(zip_t *dev, int release)
+{
+    zip_cache_t *c;
+    uint64_t start;
+    int i;
+
+    for (i = 0; i < ZIP_CACHE_BLOCKS; i++) {
+	c = &dev->cache[i];
+	if (dev->drv->f)
+		zip_cache_write_back(dev, c);
+	if (release) {
+		if (c->data)
+			free(c->data);
+		c->data = NULL;
+		c->valid = c->dirty = 0;
+	}
+    }
+
+    if (dev->drv->f) {
+	start = disk_trace_start();
+	fflush(dev->drv->f);
+	disk_trace_end(DTRACE_ZIP, dev->id, DTRACE_FLUSH, 0, start, 0);
+    }
+}
+
+
+/* Find a block in the cache, bringing it in if it is not there; if the
+   caller is about to overwrite all of it, it is not read first. Parts
+   the image file does not reach read as zeroes. */
+static zip_cache_t *
+zip_cache_get(zip_t *dev, uint32_t block, int whole)
+{
+    zip_cache_t *c = NULL;
+    uint32_t len, n;
+    uint64_t start;
+    int i;
+
+    for (i = 0; i < ZIP_CACHE_BLOCKS; i++) {
+	if (dev->cache[i].valid && (dev->cache[i].block == block)) {
+		c = &dev->cache[i];
+		c->lru = ++dev->cache_lru;
+		return c;
+	}
+    }
+
+    /* Reuse a free entry, or else the least recently used one. */
+    for (i = 0; i < ZIP_CACHE_BLOCKS; i++) {
+	if (!dev->cache[i].valid) {
+		c = &dev->cache[i];
+		break;
+	}
+	if ((c == NULL) || ((dev->cache_lru - dev->cache[i].lru) > (dev->cache_lru - c->lru)))
+		c = &dev->cache[i];
+    }
+
+    zip_cache_write_back(dev, c);
+
+    if (c->data == NULL) {
+	c->data = (uint8_t *) malloc((1 << ZIP_CACHE_SHIFT) << 9);
+	if (c->data == NULL)
+		fatal("ZIP %i: Unable to allocate the block cache\n", dev->id);
+    }
+
+    len = zip_cache_block_len(dev, block);
+    n = 0;
+    if (!whole) {
+	start = disk_trace_start();
+	fseek(dev->drv->f, dev->drv->base + (block << (ZIP_CACHE_SHIFT + 9)), SEEK_SET);
+	n = fread(c->data, 1, len, dev->drv->f);
+	disk_trace_end(DTRACE_ZIP, dev->id, DTRACE_READ, len, start, 0);
+    }
+    if (n < len)
+	memset(c->data + n, 0x00, len - n);
+
+    c->block = block;
+    c->valid = 1;
+    c->dirty = 0;
+    c->lru = ++dev->cache_lru;
+
+    return c;
+}
+
+
+/* Transfer count sectors starting at sector through the cache. */
+static void
+zip_cache_rw(zip_t *dev, uint32_t sector, uint32_t count, uint8_t *buf, int out)
+{
+    zip_cache_t *c;
+    uint32_t block, first, n;
+
+    while (count > 0) {
+	block = sector >> ZIP_CACHE_SHIFT;
+	first = sector & ((1 << ZIP_CACHE_SHIFT) - 1);
+	n = (1 << ZIP_CACHE_SHIFT) - first;
+	if (n > count)
+		n = count;
+
+	c = zip_cache_get(dev, block, out && !first && ((n << 9) >= zip_cache_block_len(dev, block)));
+	if (out) {
+		memcpy(c->data + (first << 9), buf, n << 9);
+		c->dirty = 1;
+	} else
+		memcpy(buf, c->data + (first << 9), n << 9);
+
+	sector += n;
+	count -= n;
+	buf += (n << 9);
+    }
+}
+
+
 static int
 zip_load_abort(zip_t *dev)
 {
+    zip_cache_flush(dev, 1);
     if (dev->drv->f)
 	fclose(dev->drv->f);
     dev->drv->f = NULL;
@@ -553,6 +703,8 @@ zip_disk_reload(zip_t *dev)
 void
 zip_disk_unload(zip_t *dev)
 {
+    zip_cache_flush(dev, 1);
+
     if (dev->drv->f) {
 	fclose(dev->drv->f);
 	dev->drv->f = NULL;
@@ -902,6 +1054,7 @@ zip_command_common(zip_t *dev)
 static void
 zip_command_complete(zip_t *dev)
 {
+    disk_trace_cmd_end(DTRACE_ZIP, dev->id);
     ui_sb_update_icon(SB_ZIP | dev->id, 0);
     dev->packet_status = PHASE_COMPLETE;
     zip_command_common(dev);
@@ -1005,6 +1158,7 @@ zip_set_phase(zip_t *dev, uint8_t phase)
 static void
 zip_cmd_error(zip_t *dev)
 {
+    disk_trace_cmd_end(DTRACE_ZIP, dev->id);
     zip_set_phase(dev, SCSI_PHASE_STATUS);
     dev->error = ((zip_sense_key & 0xf) << 4) | ABRT_ERR;
     if (dev->unit_attention)
@@ -1154,8 +1308,9 @@ zip_data_phase_error(zip_t *dev)
 static int
 zip_blocks(zip_t *dev, int32_t *len, int first_batch, int out)
 {
+    uint32_t n;
+
     *len = 0;
-    int i;
 
     if (!dev->sector_len) {
 	zip_command_complete(dev);
@@ -1172,18 +1327,17 @@ zip_blocks(zip_t *dev, int32_t *len, int first_batch, int out)
 
     *len = dev->requested_blocks << 9;
 
-    for (i = 0; i < dev->requested_blocks; i++) {
-	fseek(dev->drv->f, dev->drv->base + (dev->sector_pos << 9) + (i << 9), SEEK_SET);
-
-	if (feof(dev->drv->f))
-		break;
-
-	if (out)
-		fwrite(dev->buffer + (i << 9), 1, 512, dev->drv->f);
-	else
-		fread(dev->buffer + (i << 9), 1, 512, dev->drv->f);
+    /* Whatever lies past the end of the medium is dropped on writes and
+       reads as zeroes. */
+    n = dev->requested_blocks;
+    if ((dev->sector_pos + n) > dev->drv->medium_size) {
+	n = dev->drv->medium_size - dev->sector_pos;
+	if (!out)
+		memset(dev->buffer + (n << 9), 0x00, (dev->requested_blocks - n) << 9);
     }
 
+    zip_cache_rw(dev, dev->sector_pos, n, dev->buffer, out);
+
     zip_log("%s %i bytes of blocks...\n", out ? "Written" : "Read", *len);
 
     dev->sector_pos += dev->requested_blocks;
@@ -1418,6 +1572,8 @@ zip_command(scsi_common_t *sc, uint8_t *cdb)
 
     memcpy(dev->current_cdb, cdb, 12);
 
+    disk_trace_cmd_start(DTRACE_ZIP, dev->id);
+
     if (cdb[0] != 0) {
 	zip_log("ZIP %i: Command 0x%02X, Sense Key %02X, Asc %02X, Ascq %02X, Unit attention: %i\n",
 		dev->id, cdb[0], zip_sense_key, zip_asc, zip_ascq, dev->unit_attention);
@@ -2123,8 +2279,8 @@ zip_phase_data_out(scsi_common_t *sc)
 				dev->buffer[6] = (s >> 8) & 0xff;
 				dev->buffer[7] = s & 0xff;
 			}
-			fseek(dev->drv->f, dev->drv->base + (i << 9), SEEK_SET);
-			fwrite(dev->buffer, 1, 512, dev->drv->f);
+			if (i < dev->drv->medium_size)
+				zip_cache_rw(dev, i, 1, dev->buffer, 1);
 		}
 		break;
 	case GPCMD_MODE_SELECT_6:
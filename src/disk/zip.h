@@ -29,6 +29,9 @@
 
 #define ZIP_250_SECTORS (489532)
 
+#define ZIP_CACHE_BLOCKS	8	/* blocks kept per drive */
+#define ZIP_CACHE_SHIFT		7	/* 128 sectors (64 kB) per block */
+
 
 enum {
     ZIP_BUS_DISABLED = 0,
@@ -60,6 +63,15 @@ typedef struct {
 	     base;
 } zip_drive_t;
 
+typedef struct {
+    uint32_t block, lru;
+
+    uint8_t valid, dirty,
+	    pad0, pad1;
+
+    uint8_t *data;		/* allocated on first use */
+} zip_cache_t;
+
 typedef struct {
     mode_sense_pages_t ms_pages_saved;
 
@@ -86,6 +98,9 @@ typedef struct {
 	     packet_len, pos;
 
     double callback;
+
+    zip_cache_t cache[ZIP_CACHE_BLOCKS];
+    uint32_t cache_lru;
 } zip_t;
 
 
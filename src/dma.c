@@ -972,13 +972,10 @@ dma_mode(int channel)
 void
 DMAPageRead(uint32_t PhysAddress, uint8_t *DataRead, uint32_t TotalSize)
 {
-    uint32_t i = 0;
-
 #if 0
     memcpy(DataRead, &ram[PhysAddress], TotalSize);
 #else
-    for (i = 0; i < TotalSize; i++)
-	DataRead[i] = mem_readb_phys(PhysAddress + i);
+    mem_read_phys(DataRead, PhysAddress, TotalSize);
 #endif
 }
 
@@ -986,14 +983,11 @@ DMAPageRead(uint32_t PhysAddress, uint8_t *DataRead, uint32_t TotalSize)
 void
 DMAPageWrite(uint32_t PhysAddress, const uint8_t *DataWrite, uint32_t TotalSize)
 {
-    uint32_t i = 0;
-
 #if 0
     mem_invalidate_range(PhysAddress, PhysAddress + TotalSize - 1);
     memcpy(&ram[PhysAddress], DataWrite, TotalSize);
 #else
-    for (i = 0; i < TotalSize; i++)
-	mem_writeb_phys(PhysAddress + i, DataWrite[i]);
+    mem_write_phys((void *) DataWrite, PhysAddress, TotalSize);
 
     mem_invalidate_range(PhysAddress, PhysAddress + TotalSize - 1);
 #endif
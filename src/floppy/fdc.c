@@ -1726,6 +1726,14 @@ fdc_is_verify(fdc_t *fdc)
 }
 
 
+/* Data moves by DMA, so it can be transferred a whole sector at a time. */
+int
+fdc_is_dma(fdc_t *fdc)
+{
+    return (!(fdc->flags & FDC_FLAG_PCJR) && fdc->dma) ? 1 : 0;
+}
+
+
 int
 fdc_data(fdc_t *fdc, uint8_t data)
 {
@@ -151,6 +151,7 @@ extern void	fdc_sector_finishcompare(fdc_t *fdc, int satisfying);
 extern void	fdc_sector_finishread(fdc_t *fdc);
 extern void	fdc_track_finishread(fdc_t *fdc, int condition);
 extern int	fdc_is_verify(fdc_t *fdc);
+extern int	fdc_is_dma(fdc_t *fdc);
 
 extern void	fdc_overrun(fdc_t *fdc);
 extern void	fdc_set_base(fdc_t *fdc, int base);
@@ -2166,26 +2166,33 @@ d86f_turbo_read(int drive, int side)
     int recv_data = 0;
     int read_status = 0;
     uint8_t flags = d86f_sector_flags(drive, side, dev->req_sector.id.c, dev->req_sector.id.h, dev->req_sector.id.r, dev->req_sector.id.n);
+    int bulk;
 
-    if (d86f_handler[drive].read_data != NULL)
-	dat = d86f_handler[drive].read_data(drive, side, dev->turbo_pos);
-    else
-	dat = (random_generate() & 0xff);
-    dev->turbo_pos++;
+    /* With DMA, a good sector goes in one poll instead of one byte per
+       poll; damaged ones keep the byte timing. */
+    bulk = fdc_is_dma(d86f_fdc) && !(flags & SECTOR_CRC_ERROR);
 
-    if (dev->state == STATE_11_SCAN_DATA) {
-	/* Scan/compare command. */
-	recv_data = d86f_get_data(drive, 0);
-	d86f_compare_byte(drive, recv_data, dat);
-    } else {
-	if (dev->data_find.bytes_obtained < (128UL << dev->last_sector.id.n)) {
-		if (dev->state != STATE_16_VERIFY_DATA) {
-			read_status = fdc_data(d86f_fdc, dat);
-			if (read_status == -1)
-				dev->dma_over++;
+    do {
+	if (d86f_handler[drive].read_data != NULL)
+		dat = d86f_handler[drive].read_data(drive, side, dev->turbo_pos);
+	else
+		dat = (random_generate() & 0xff);
+	dev->turbo_pos++;
+
+	if (dev->state == STATE_11_SCAN_DATA) {
+		/* Scan/compare command. */
+		recv_data = d86f_get_data(drive, 0);
+		d86f_compare_byte(drive, recv_data, dat);
+	} else {
+		if (dev->data_find.bytes_obtained < (128UL << dev->last_sector.id.n)) {
+			if (dev->state != STATE_16_VERIFY_DATA) {
+				read_status = fdc_data(d86f_fdc, dat);
+				if (read_status == -1)
+					dev->dma_over++;
+			}
 		}
 	}
-    }
+    } while (bulk && (dev->turbo_pos < (128 << dev->last_sector.id.n)));
 
     if (dev->turbo_pos >= (128 << dev->last_sector.id.n)) {
 	dev->data_find.sync_marks = dev->data_find.bits_obtained = dev->data_find.bytes_obtained = 0;
@@ -2222,11 +2229,14 @@ d86f_turbo_write(int drive, int side)
 {
     d86f_t *dev = d86f[drive];
     uint8_t dat = 0;
+    int bulk = fdc_is_dma(d86f_fdc);
 
-    dat = d86f_get_data(drive, 1);
-    d86f_handler[drive].write_data(drive, side, dev->turbo_pos, dat);
+    do {
+	dat = d86f_get_data(drive, 1);
+	d86f_handler[drive].write_data(drive, side, dev->turbo_pos, dat);
 
-    dev->turbo_pos++;
+	dev->turbo_pos++;
+    } while (bulk && (dev->turbo_pos < (128 << dev->last_sector.id.n)));
 
     if (dev->turbo_pos >= (128 << dev->last_sector.id.n)) {
 	/* We've written the data. */
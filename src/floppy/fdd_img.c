@@ -38,6 +38,7 @@
 #include "fdd_86f.h"
 #include "fdd_img.h"
 #include "fdc.h"
+#include "../disk/disk_trace.h"
 
 
 typedef struct {
@@ -393,15 +394,20 @@ write_back(int drive)
 {
     img_t *dev = img[drive];
     int ssize = 128 << ((int) dev->sector_size);
-    int side;
+    int side, error = 0;
+    uint64_t start;
 
     if (dev->f == NULL) return;
 
     if (dev->disk_at_once) return;
-		
+
+    start = disk_trace_start();
     fseek(dev->f, dev->base + (dev->track * dev->sectors * ssize * dev->sides), SEEK_SET);
-    for (side = 0; side < dev->sides; side++)
-	fwrite(dev->track_data[side], dev->sectors * ssize, 1, dev->f);
+    for (side = 0; side < dev->sides; side++) {
+	if (fwrite(dev->track_data[side], dev->sectors * ssize, 1, dev->f) != 1)
+		error = 1;
+    }
+    disk_trace_end(DTRACE_FDD, drive, DTRACE_WRITE, dev->sectors * ssize * dev->sides, start, error);
 }
 
 
@@ -475,6 +481,7 @@ img_seek(int drive, int track)
     int is_t0, sector, current_pos, img_pos, sr, sside, total, array_sector, buf_side, buf_pos;
     int ssize = 128 << ((int) dev->sector_size);
     uint32_t cur_pos = 0;
+    uint64_t start = 0;
 
     if (dev->f == NULL) return;
 
@@ -486,8 +493,10 @@ img_seek(int drive, int track)
 
     is_t0 = (track == 0) ? 1 : 0;
 
-    if (! dev->disk_at_once)
+    if (! dev->disk_at_once) {
+	start = disk_trace_start();
 	fseek(dev->f, dev->base + (track * dev->sectors * ssize * dev->sides), SEEK_SET);
+    }
 
     for (side = 0; side < dev->sides; side++) {
 	if (dev->disk_at_once) {
@@ -500,6 +509,9 @@ img_seek(int drive, int track)
 	}
     }
 
+    if (! dev->disk_at_once)
+	disk_trace_end(DTRACE_FDD, drive, DTRACE_READ, dev->sectors * ssize * dev->sides, start, 0);
+
     d86f_reset_index_hole_pos(drive, 0);
     d86f_reset_index_hole_pos(drive, 1);
 
@@ -68,6 +68,10 @@
 #define MEM_GRANULARITY_PAGE	(MEM_GRANULARITY_MASK & ~0xfff)
 #endif
 
+/* Maximum number of entries in the read/write lookup tables; the
+   size in use and its set associativity are configurable. */
+#define MEM_LOOKUP_MAX		1024
+
 
 typedef struct _mem_mapping_ {
     struct _mem_mapping_ *prev, *next;
@@ -121,6 +125,8 @@ typedef struct page_t
 
     uint64_t *byte_dirty_mask;
     uint64_t *byte_code_present_mask;
+
+    uint16_t	icache;		/* interpreter instruction cache slot + 1 */
 } page_t;
 
 extern uint32_t purgable_page_list_head;
@@ -146,6 +152,8 @@ typedef struct _page_ {
 
     /*Head of codeblock tree associated with this page*/
     struct codeblock_t *head;
+
+    uint16_t	icache;		/* interpreter instruction cache slot + 1 */
 } page_t;
 #endif
 
@@ -156,14 +164,12 @@ extern uint32_t		rammask;
 extern uint8_t		*rom;
 extern uint32_t		biosmask, biosaddr;
 
-extern int		readlookup[256],
-			readlookupp[256];
+extern int		readlookup[MEM_LOOKUP_MAX],
+			readlookupp[MEM_LOOKUP_MAX];
 extern uintptr_t *	readlookup2;
-extern int		readlnext;
-extern int		writelookup[256],
-			writelookupp[256];
+extern int		writelookup[MEM_LOOKUP_MAX],
+			writelookupp[MEM_LOOKUP_MAX];
 extern uintptr_t	*writelookup2;
-extern int		writelnext;
 extern uint32_t		ram_mapped_addr[64];
 
 mem_mapping_t		base_mapping,
@@ -187,6 +193,10 @@ extern int		shadowbios,
 			shadowbios_write;
 extern int		readlnum,
 			writelnum;
+extern int		readlevict,
+			writelevict;
+extern int		cachesize,
+			cacheways;
 
 extern int		memspeed[11];
 
@@ -266,6 +276,8 @@ extern void	mem_set_mem_state(uint32_t base, uint32_t size, int state);
 extern uint8_t	mem_readb_phys(uint32_t addr);
 extern uint16_t	mem_readw_phys(uint32_t addr);
 extern void	mem_writeb_phys(uint32_t addr, uint8_t val);
+extern void	mem_read_phys(void *dest, uint32_t addr, int transfer_size);
+extern void	mem_write_phys(void *src, uint32_t addr, int transfer_size);
 
 extern uint8_t	mem_read_ram(uint32_t addr, void *priv);
 extern uint16_t	mem_read_ramw(uint32_t addr, void *priv);
@@ -292,6 +304,8 @@ extern void	mem_write_ramb_page(uint32_t addr, uint8_t val, page_t *p);
 extern void	mem_write_ramw_page(uint32_t addr, uint16_t val, page_t *p);
 extern void	mem_write_raml_page(uint32_t addr, uint32_t val, page_t *p);
 extern void	mem_flush_write_page(uint32_t addr, uint32_t virt);
+extern void	mem_flush_write_ram_page(uint32_t addr);
+extern int	mem_code_ram_page(uint32_t virt);
 
 extern void	mem_reset_page_blocks(void);
 
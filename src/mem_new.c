@@ -78,13 +78,11 @@ uint32_t		biosmask, biosaddr;
 uint32_t		pccache;
 uint8_t			*pccache2;
 
-int			readlnext;
-int			readlookup[256],
-			readlookupp[256];
+int			readlookup[MEM_LOOKUP_MAX],
+			readlookupp[MEM_LOOKUP_MAX];
 uintptr_t		*readlookup2;
-int			writelnext;
-int			writelookup[256],
-			writelookupp[256];
+int			writelookup[MEM_LOOKUP_MAX],
+			writelookupp[MEM_LOOKUP_MAX];
 uintptr_t		*writelookup2;
 
 uint32_t		mem_logical_addr;
@@ -93,7 +91,10 @@ int			shadowbios = 0,
 			shadowbios_write;
 int			readlnum = 0,
 			writelnum = 0;
-int			cachesize = 256;
+int			readlevict = 0,
+			writelevict = 0;
+int			cachesize = 256,	/* entries per lookup table */
+			cacheways = 0;		/* ways per set, 0 = fully assoc. */
 
 uint32_t		get_phys_virt,
 			get_phys_phys;
@@ -118,6 +119,11 @@ static mem_mapping_t	*write_mapping[MEM_MAPPINGS_NO];
 static uint8_t		*_mem_exec[MEM_MAPPINGS_NO];
 static int		_mem_state[MEM_MAPPINGS_NO];
 
+static int		lookup_ways,
+			lookup_sets_mask;
+static int		readlnext[MEM_LOOKUP_MAX],	/* per-set victims */
+			writelnext[MEM_LOOKUP_MAX];
+
 #if FIXME
 #if (MEM_GRANULARITY_BITS >= 12)
 static uint8_t		ff_array[MEM_GRANULARITY_SIZE];
@@ -158,6 +164,38 @@ mem_addr_is_ram(uint32_t addr)
 }
 
 
+/*
+ * The read and write lookup tables are split into (cachesize / ways)
+ * sets, selected by the low bits of the virtual page number, and each
+ * set is replaced in round-robin order. With ways == cachesize this is
+ * the original single rotating ring.
+ */
+static void
+mem_lookup_recalc(void)
+{
+    if ((cachesize < 16) || (cachesize > MEM_LOOKUP_MAX) || (cachesize & (cachesize - 1)))
+	cachesize = 256;
+
+    lookup_ways = cacheways;
+    if ((lookup_ways <= 0) || (lookup_ways > cachesize) || (lookup_ways & (lookup_ways - 1)))
+	lookup_ways = cachesize;
+
+    lookup_sets_mask = (cachesize / lookup_ways) - 1;
+}
+
+
+static __inline int
+mem_lookup_slot(uint32_t virt, int *next)
+{
+    int set = (virt >> 12) & lookup_sets_mask;
+    int slot = (set * lookup_ways) + next[set];
+
+    next[set] = (next[set] + 1) & (lookup_ways - 1);
+
+    return slot;
+}
+
+
 void
 resetreadlookup(void)
 {
@@ -175,8 +213,10 @@ mem_log("MEM: reset_lookup: pages=%08lx, lookup=%08lx, pages_sz=%i\n", pages, pa
     memset(page_lookup, 0x00, (1<<20)*sizeof(page_t *));
 #endif
 
+    mem_lookup_recalc();
+
     /* Initialize the tables for lower (<= 1024K) RAM. */
-    for (c = 0; c < 256; c++) {
+    for (c = 0; c < MEM_LOOKUP_MAX; c++) {
 	readlookup[c] = 0xffffffff;
 	writelookup[c] = 0xffffffff;
     }
@@ -190,8 +230,8 @@ mem_log("MEM: reset_lookup: pages=%08lx, lookup=%08lx, pages_sz=%i\n", pages, pa
     memset(writelookup2, 0xff, (1<<20)*sizeof(uintptr_t));
 #endif
 
-    readlnext = 0;
-    writelnext = 0;
+    memset(readlnext, 0x00, sizeof(readlnext));
+    memset(writelnext, 0x00, sizeof(writelnext));
     pccache = 0xffffffff;
 }
 
@@ -201,7 +241,7 @@ flushmmucache(void)
 {
     int c;
 
-    for (c = 0; c < 256; c++) {
+    for (c = 0; c < cachesize; c++) {
 	if (readlookup[c] != (int) 0xffffffff) {
 		readlookup2[readlookup[c]] = -1;
 		readlookup[c] = 0xffffffff;
@@ -228,7 +268,7 @@ flushmmucache_nopc(void)
 {
     int c;
 
-    for (c = 0; c < 256; c++) {
+    for (c = 0; c < cachesize; c++) {
 	if (readlookup[c] != (int) 0xffffffff) {
 		readlookup2[readlookup[c]] = -1;
 		readlookup[c] = 0xffffffff;
@@ -247,7 +287,7 @@ flushmmucache_cr3(void)
 {
     int c;
 
-    for (c = 0; c < 256; c++) {
+    for (c = 0; c < cachesize; c++) {
 	if (readlookup[c] != (int) 0xffffffff) {
 		readlookup2[readlookup[c]] = -1;
 		readlookup[c] = 0xffffffff;
@@ -267,7 +307,7 @@ mem_flush_write_page(uint32_t addr, uint32_t virt)
     page_t *page_target = &pages[addr >> 12];
     int c;
 
-    for (c = 0; c < 256; c++) {
+    for (c = 0; c < cachesize; c++) {
 	if (writelookup[c] != (int) 0xffffffff) {
 		uintptr_t target = (uintptr_t)&ram[(uintptr_t)(addr & ~0xfff) - (virt & ~0xfff)];
 
@@ -281,6 +321,25 @@ mem_flush_write_page(uint32_t addr, uint32_t virt)
 }
 
 
+/* Make every write lookup that goes straight to the given RAM page go
+   through the page's write functions instead. The lookups are converted
+   in place rather than dropped, so the guest sees no extra TLB misses. */
+void
+mem_flush_write_ram_page(uint32_t addr)
+{
+    uintptr_t target = (uintptr_t) &ram[addr & ~0xfff];
+    int c;
+
+    for (c = 0; c < cachesize; c++) {
+	if ((writelookup[c] != (int) 0xffffffff) && (writelookup2[writelookup[c]] != (uintptr_t) -1) &&
+	    ((writelookup2[writelookup[c]] + ((uintptr_t) writelookup[c] << 12)) == target)) {
+		writelookup2[writelookup[c]] = -1;
+		page_lookup[writelookup[c]] = &pages[addr >> 12];
+	}
+    }
+}
+
+
 #define mmutranslate_read(addr) mmutranslatereal(addr,0)
 #define mmutranslate_write(addr) mmutranslatereal(addr,1)
 #define rammap(x)	((uint32_t *)(_mem_exec[(x) >> MEM_GRANULARITY_BITS]))[((x) >> 2) & MEM_GRANULARITY_QMASK]
@@ -410,18 +469,24 @@ mem_addr_translate(uint32_t addr, uint32_t chunk_start, uint32_t len)
 void
 addreadlookup(uint32_t virt, uint32_t phys)
 {
+    int slot;
+
     if (virt == 0xffffffff) return;
 
     if (readlookup2[virt>>12] != (uintptr_t) -1) return;
 
-    if (readlookup[readlnext] != (int) 0xffffffff)
-	readlookup2[readlookup[readlnext]] = -1;
+    slot = mem_lookup_slot(virt, readlnext);
+
+    if (readlookup[slot] != (int) 0xffffffff) {
+	readlookup2[readlookup[slot]] = -1;
+	readlevict++;
+    }
 
     readlookup2[virt>>12] = (uintptr_t)&ram[(uintptr_t)(phys & ~0xFFF) - (uintptr_t)(virt & ~0xfff)];
 
-    readlookupp[readlnext] = mmu_perm;
-    readlookup[readlnext++] = virt >> 12;
-    readlnext &= (cachesize-1);
+    readlookupp[slot] = mmu_perm;
+    readlookup[slot] = virt >> 12;
+    readlnum++;
 
     sub_cycles(9);
 }
@@ -430,28 +495,70 @@ addreadlookup(uint32_t virt, uint32_t phys)
 void
 addwritelookup(uint32_t virt, uint32_t phys)
 {
+    int slot;
+
     if (virt == 0xffffffff) return;
 
     if (page_lookup[virt >> 12]) return;
 
-    if (writelookup[writelnext] != -1) {
-	page_lookup[writelookup[writelnext]] = NULL;
-	writelookup2[writelookup[writelnext]] = -1;
+    slot = mem_lookup_slot(virt, writelnext);
+
+    if (writelookup[slot] != -1) {
+	page_lookup[writelookup[slot]] = NULL;
+	writelookup2[writelookup[slot]] = -1;
+	writelevict++;
     }
 
-    if (pages[phys >> 12].block || (phys & ~0xfff) == recomp_page)
+    if (pages[phys >> 12].block || pages[phys >> 12].icache || (phys & ~0xfff) == recomp_page)
 	page_lookup[virt >> 12] = &pages[phys >> 12];//(uintptr_t)&ram[(uintptr_t)(phys & ~0xFFF) - (uintptr_t)(virt & ~0xfff)];
     else
 	writelookup2[virt>>12] = (uintptr_t)&ram[(uintptr_t)(phys & ~0xFFF) - (uintptr_t)(virt & ~0xfff)];
 
-    writelookupp[writelnext] = mmu_perm;
-    writelookup[writelnext++] = virt >> 12;
-    writelnext &= (cachesize - 1);
+    writelookupp[slot] = mmu_perm;
+    writelookup[slot] = virt >> 12;
+    writelnum++;
 
     sub_cycles(9);
 }
 
 
+/*
+ * Page-crossing accesses where both pages are already in the lookup
+ * tables can be done directly, without translating either address.
+ */
+static __inline int
+mem_read_split(uint32_t addr, int len, uint32_t *val)
+{
+    int i;
+
+    if ((readlookup2[addr >> 12] == (uintptr_t) -1) ||
+	(readlookup2[(addr + len - 1) >> 12] == (uintptr_t) -1))
+	return 0;
+
+    *val = 0;
+    for (i = 0; i < len; i++)
+	*val |= ((uint32_t) *(uint8_t *)(readlookup2[(addr + i) >> 12] + addr + i)) << (i << 3);
+
+    return 1;
+}
+
+
+static __inline int
+mem_write_split(uint32_t addr, int len, uint32_t val)
+{
+    int i;
+
+    if ((writelookup2[addr >> 12] == (uintptr_t) -1) ||
+	(writelookup2[(addr + len - 1) >> 12] == (uintptr_t) -1))
+	return 0;
+
+    for (i = 0; i < len; i++)
+	*(uint8_t *)(writelookup2[(addr + i) >> 12] + addr + i) = val >> (i << 3);
+
+    return 1;
+}
+
+
 uint8_t *
 getpccache(uint32_t a)
 {
@@ -487,6 +594,33 @@ getpccache(uint32_t a)
 }
 
 
+/* The RAM page the code at virt runs from, for the interpreter's
+   instruction cache, or -1 if it is not plain RAM at its own physical
+   address (ROM, shadowed BIOS, EMS windows and the like), where writes
+   would not reach the page's write functions. pccache must have just
+   been loaded for virt. */
+int
+mem_code_ram_page(uint32_t virt)
+{
+    uint32_t a = virt;
+
+    if (cr0 >> 31) {
+	a = mmutranslate_noabrt(a, 0);
+	if (a == 0xffffffff)
+		return -1;
+    }
+    a &= rammask;
+
+    if (((a >= 0xa0000) && (a < 0x100000)) || ((a >> 10) >= mem_size) || ((a >> 12) >= pages_sz))
+	return -1;
+
+    if (&pccache2[virt & ~0xfff] != &ram[a & ~0xfff])
+	return -1;
+
+    return a >> 12;
+}
+
+
 uint8_t
 readmembl(uint32_t addr)
 {
@@ -534,6 +668,7 @@ uint16_t
 readmemwl(uint32_t addr)
 {
     mem_mapping_t *map;
+    uint32_t val;
 
     mem_logical_addr = addr;
 
@@ -541,6 +676,8 @@ readmemwl(uint32_t addr)
 	if (!cpu_cyrix_alignment || (addr & 7) == 7)
 		sub_cycles(timing_misaligned);
 	if ((addr & 0xFFF) > 0xFFE) {
+		if (mem_read_split(addr, 2, &val))
+			return val;
 		if (cr0 >> 31) {
 			if (mmutranslate_read(addr)   == 0xffffffff)
 				return 0xffff;
@@ -583,6 +720,8 @@ writememwl(uint32_t addr, uint16_t val)
 	if (!cpu_cyrix_alignment || (addr & 7) == 7)
 		sub_cycles(timing_misaligned);
 	if ((addr & 0xFFF) > 0xFFE) {
+		if (mem_write_split(addr, 2, val))
+			return;
 		if (cr0 >> 31) {
 			if (mmutranslate_write(addr)   == 0xffffffff)
 				return;
@@ -626,6 +765,7 @@ uint32_t
 readmemll(uint32_t addr)
 {
     mem_mapping_t *map;
+    uint32_t val;
 
     mem_logical_addr = addr;
 
@@ -633,6 +773,8 @@ readmemll(uint32_t addr)
 	if (!cpu_cyrix_alignment || (addr & 7) > 4)
 		sub_cycles(timing_misaligned);
 	if ((addr&0xFFF)>0xFFC) {
+		if (mem_read_split(addr, 4, &val))
+			return val;
 		if (cr0>>31) {
 			if (mmutranslate_read(addr)   == 0xffffffff)
 				return 0xffffffff;
@@ -680,6 +822,8 @@ writememll(uint32_t addr, uint32_t val)
 	if (!cpu_cyrix_alignment || (addr & 7) > 4)
 		sub_cycles(timing_misaligned);
 	if ((addr & 0xFFF) > 0xFFC) {
+		if (mem_write_split(addr, 4, val))
+			return;
 		if (cr0>>31) {
 			if (mmutranslate_write(addr)   == 0xffffffff)
 				return;
@@ -883,6 +1027,58 @@ mem_writeb_phys(uint32_t addr, uint8_t val)
 }
 
 
+/* Block versions of the above, copying straight from and to RAM and going
+   through the mappings only where there is no RAM behind them. */
+void
+mem_read_phys(void *dest, uint32_t addr, int transfer_size)
+{
+    uint8_t *p = (uint8_t *) dest;
+    int i, n;
+
+    while (transfer_size > 0) {
+	n = MEM_GRANULARITY_SIZE - (addr & MEM_GRANULARITY_MASK);
+	if (n > transfer_size)
+		n = transfer_size;
+
+	if (_mem_exec[addr >> MEM_GRANULARITY_BITS])
+		memcpy(p, &_mem_exec[addr >> MEM_GRANULARITY_BITS][addr & MEM_GRANULARITY_MASK], n);
+	else {
+		for (i = 0; i < n; i++)
+			p[i] = mem_readb_phys(addr + i);
+	}
+
+	p += n;
+	addr += n;
+	transfer_size -= n;
+    }
+}
+
+
+void
+mem_write_phys(void *src, uint32_t addr, int transfer_size)
+{
+    uint8_t *p = (uint8_t *) src;
+    int i, n;
+
+    while (transfer_size > 0) {
+	n = MEM_GRANULARITY_SIZE - (addr & MEM_GRANULARITY_MASK);
+	if (n > transfer_size)
+		n = transfer_size;
+
+	if (_mem_exec[addr >> MEM_GRANULARITY_BITS])
+		memcpy(&_mem_exec[addr >> MEM_GRANULARITY_BITS][addr & MEM_GRANULARITY_MASK], p, n);
+	else {
+		for (i = 0; i < n; i++)
+			mem_writeb_phys(addr + i, p[i]);
+	}
+
+	p += n;
+	addr += n;
+	transfer_size -= n;
+    }
+}
+
+
 uint8_t
 mem_read_ram(uint32_t addr, void *priv)
 {
@@ -954,6 +1150,8 @@ mem_write_ramb_page(uint32_t addr, uint8_t val, page_t *p)
 
 	p->mem[addr & 0xfff] = val;
 	p->dirty_mask |= mask;
+	if (p->icache)
+		x386_icache_write(p->icache, addr, 1);
 	if ((p->code_present_mask & mask) && !page_in_evict_list(p))
 		page_add_to_evict_list(p);
 	p->byte_dirty_mask[byte_offset] |= byte_mask;
@@ -975,6 +1173,8 @@ mem_write_ramw_page(uint32_t addr, uint16_t val, page_t *p)
 		mask |= (mask << 1);
 	*(uint16_t *)&p->mem[addr & 0xfff] = val;
 	p->dirty_mask |= mask;
+	if (p->icache)
+		x386_icache_write(p->icache, addr, 2);
 	if ((p->code_present_mask & mask) && !page_in_evict_list(p))
 		page_add_to_evict_list(p);
 	if ((addr & PAGE_BYTE_MASK_MASK) == PAGE_BYTE_MASK_MASK) {
@@ -1004,6 +1204,8 @@ mem_write_raml_page(uint32_t addr, uint32_t val, page_t *p)
 		mask |= (mask << 1);
 	*(uint32_t *)&p->mem[addr & 0xfff] = val;
 	p->dirty_mask |= mask;
+	if (p->icache)
+		x386_icache_write(p->icache, addr, 4);
 	p->byte_dirty_mask[byte_offset] |= byte_mask;
 	if (!page_in_evict_list(p) && ((p->code_present_mask & mask) || (p->byte_code_present_mask[byte_offset] & byte_mask)))
 		page_add_to_evict_list(p);
@@ -1170,6 +1372,15 @@ mem_invalidate_range(uint32_t start_addr, uint32_t end_addr)
 {
     uint64_t mask;
     page_t *p;
+    uint32_t cur_addr, first;
+
+    for (cur_addr = (start_addr >> 12); (cur_addr <= (end_addr >> 12)) && (cur_addr < pages_sz); cur_addr++) {
+	if (pages[cur_addr].icache) {
+		first = (cur_addr == (start_addr >> 12)) ? start_addr : (cur_addr << 12);
+		x386_icache_write(pages[cur_addr].icache, first,
+				  MIN(end_addr, (cur_addr << 12) | 0xfff) - first + 1);
+	}
+    }
 
     start_addr &= ~PAGE_MASK_MASK;
     end_addr = (end_addr + PAGE_MASK_MASK) & ~PAGE_MASK_MASK;        
@@ -1506,6 +1717,9 @@ mem_reset(void)
 {
     uint32_t c, m;
 
+    /* The interpreter's cache refers to the old RAM and page table. */
+    x386_icache_flush();
+
     m = 1024UL * mem_size;
     if (ram != NULL) {
 	free(ram);
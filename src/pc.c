@@ -34,6 +34,7 @@
 #ifdef USE_DYNAREC
 #include "cpu_new/cpu.h"
 # include "cpu_new/codegen.h"
+# include "cpu_new/codegen_allocator.h"
 #endif
 #include "cpu_new/x86_ops.h"
 #else
@@ -72,11 +73,14 @@
 #include "scsi/scsi_device.h"
 #include "cdrom/cdrom.h"
 #include "disk/zip.h"
+#include "disk/disk_trace.h"
 #include "scsi/scsi_disk.h"
 #include "cdrom/cdrom_image.h"
+#include "cdrom/cdrom_image_backend.h"
 #include "network/network.h"
 #include "sound/sound.h"
 #include "sound/midi.h"
+#include "sound/snd_capture.h"
 #include "sound/snd_speaker.h"
 #include "video/video.h"
 #include "ui.h"
@@ -95,6 +99,7 @@ int	force_debug = 0;			/* (O) force debug output */
 int	video_fps = RENDER_FPS;			/* (O) render speed in fps */
 #endif
 int	settings_only = 0;			/* (O) show only the settings dialog */
+int	exit_status = 1;			/* (O) when pc_init() says to exit */
 #ifdef _WIN32
 uint64_t	unique_id = 0;
 uint64_t	source_hwnd = 0;
@@ -140,7 +145,9 @@ int	enable_discord = 0;			/* (C) enable Discord integration */
 extern int
 	mmuflush,
 	readlnum,
-	writelnum;
+	writelnum,
+	readlevict,
+	writelevict;
 
 int	fps, framecount;			/* emulator % */
 
@@ -346,6 +353,15 @@ usage:
 		printf("\nUsage: 86box [options] [cfg-file]\n\n");
 		printf("Valid options are:\n\n");
 		printf("-? or --help         - show this information\n");
+		printf("-A or --capture path - capture audio output to WAV file 'path'\n");
+		printf("--capture-sources    - with -A, also capture each sound source\n");
+		printf("--wavcmp ref test    - compare two captures, then exit with status\n");
+		printf("                       0 if identical, 1 if they differ, 2 on error\n");
+		printf("--cdz in out         - compress CD-ROM image file 'in' to 'out', then exit\n");
+		printf("                       with status 0 on success, 1 on error\n");
+		printf("--hdz in out         - compress hard disk image file 'in' to 'out', then exit\n");
+		printf("                       with status 0 on success, 1 on error\n");
+		printf("--iotrace path       - save disk I/O statistics to JSON file 'path' at exit\n");
 		printf("-C or --dumpcfg      - dump config file after loading\n");
 #ifdef _WIN32
 		printf("-D or --debug        - force debug output logging\n");
@@ -359,6 +375,32 @@ usage:
 #endif
 		printf("\nA config file can be specified. If none is, the default file will be used.\n");
 		return(0);
+	} else if (!wcscasecmp(argv[c], L"--capture") ||
+		   !wcscasecmp(argv[c], L"-A")) {
+		if ((c+1) == argc) goto usage;
+
+		wcscpy(sound_capture_path, argv[++c]);
+	} else if (!wcscasecmp(argv[c], L"--capture-sources")) {
+		sound_capture_sources = 1;
+	} else if (!wcscasecmp(argv[c], L"--wavcmp")) {
+		if ((c+2) >= argc) goto usage;
+
+		exit_status = sound_capture_compare(argv[c+1], argv[c+2]);
+		return(0);
+	} else if (!wcscasecmp(argv[c], L"--cdz")) {
+		if ((c+2) >= argc) goto usage;
+
+		exit_status = cdz_convert(argv[c+1], argv[c+2]);
+		return(0);
+	} else if (!wcscasecmp(argv[c], L"--hdz")) {
+		if ((c+2) >= argc) goto usage;
+
+		exit_status = hdz_convert(argv[c+1], argv[c+2]);
+		return(0);
+	} else if (!wcscasecmp(argv[c], L"--iotrace")) {
+		if ((c+1) == argc) goto usage;
+
+		wcscpy(disk_trace_path, argv[++c]);
 	} else if (!wcscasecmp(argv[c], L"--dumpcfg") ||
 		   !wcscasecmp(argv[c], L"-C")) {
 		do_dump_config = 1;
@@ -606,10 +648,14 @@ pc_init_modules(void)
 
     video_init();
 
+    disk_trace_init();
+
     fdd_init();
 
     sound_init();
 
+    sound_capture_start();
+
     hdc_init();
 
     video_reset_close();
@@ -686,7 +732,7 @@ pc_reset_hard_close(void)
 
     scsi_disk_close();
 
-    closeal();
+    sound_backend_close();
 
     video_reset_close();
 }
@@ -877,11 +923,16 @@ pc_close(thread_t *ptr)
 
     sound_cd_thread_end();
 
+    sound_capture_stop();
+
     cdrom_close();
 
     zip_close();
 
     scsi_disk_close();
+
+    if (disk_trace_path[0] != L'\0')
+	disk_trace_save(disk_trace_path);
 }
 
 
@@ -950,7 +1001,27 @@ pc_thread(void *param)
 		if (++framecountx >= 100) {
 			framecountx = 0;
 
+			pc_log("PC: lookup fills %i/%i, evictions %i/%i, flushes %i\n",
+			       readlnum, writelnum, readlevict, writelevict, mmuflush);
 			readlnum = writelnum = 0;
+			readlevict = writelevict = 0;
+#if defined(USE_NEW_DYNAREC) && defined(USE_DYNAREC)
+			pc_log("PC: code cache %i/%i blocks, %i allocation failures, %i evictions, %i recompiles\n",
+			       codegen_allocator_usage, codegen_allocator_nr, codegen_allocator_failures,
+			       cpu_recomp_cache_evicted, cpu_new_blocks);
+			codegen_allocator_failures = 0;
+			cpu_recomp_cache_evicted = cpu_new_blocks = 0;
+#endif
+			if (midi_underruns || midi_overruns) {
+				pc_log("PC: MIDI output %u underruns, %u overruns\n",
+				       midi_underruns, midi_overruns);
+				midi_underruns = midi_overruns = 0;
+			}
+			if (cdrom_audio_underruns || cdrom_audio_misses) {
+				pc_log("PC: CD audio read-ahead %u hits, %u underruns, %u misses\n",
+				       cdrom_audio_hits, cdrom_audio_underruns, cdrom_audio_misses);
+			}
+			cdrom_audio_hits = cdrom_audio_underruns = cdrom_audio_misses = 0;
 			egareads = egawrites = 0;
 			mmuflush = 0;
 			frames = 0;
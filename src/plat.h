@@ -87,6 +87,9 @@ extern int	plat_dir_create(wchar_t *path);
 extern uint64_t	plat_timer_read(void);
 extern uint32_t	plat_get_ticks(void);
 extern void	plat_delay_ms(uint32_t count);
+extern int	plat_file_id(const wchar_t *path, uint64_t *id);
+extern void	*plat_shm_open(const wchar_t *name, uint64_t size);
+extern void	plat_shm_close(void *p);
 extern void	plat_pause(int p);
 extern void	plat_mouse_capture(int on);
 extern int	plat_vidapi(char *name);
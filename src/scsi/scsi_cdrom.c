@@ -36,6 +36,7 @@
 #include "../plat.h"
 #include "../ui.h"
 #include "../cdrom/cdrom.h"
+#include "../disk/disk_trace.h"
 #include "scsi_cdrom.h"
 
 
@@ -694,6 +695,7 @@ scsi_cdrom_command_common(scsi_cdrom_t *dev)
 static void
 scsi_cdrom_command_complete(scsi_cdrom_t *dev)
 {
+    disk_trace_cmd_end(DTRACE_CDROM, dev->id);
     ui_sb_update_icon(SB_CDROM | dev->id, 0);
     dev->packet_status = PHASE_COMPLETE;
     scsi_cdrom_command_common(dev);
@@ -795,6 +797,7 @@ scsi_cdrom_set_phase(scsi_cdrom_t *dev, uint8_t phase)
 static void
 scsi_cdrom_cmd_error(scsi_cdrom_t *dev)
 {
+    disk_trace_cmd_end(DTRACE_CDROM, dev->id);
     scsi_cdrom_set_phase(dev, SCSI_PHASE_STATUS);
     dev->error = ((scsi_cdrom_sense_key & 0xf) << 4) | ABRT_ERR;
     if (dev->unit_attention)
@@ -987,6 +990,13 @@ scsi_cdrom_read_data(scsi_cdrom_t *dev, int msf, int type, int flags, int32_t *l
     dev->old_len = 0;
     *len = 0;
 
+    /* Plain 2048-byte reads can be done in one go. */
+    if (!msf && (flags == 0x10) && ((type == 2) || (type == 8)) &&
+	cdrom_read_data_sectors(dev->drv, dev->buffer, dev->sector_pos, dev->requested_blocks)) {
+	dev->old_len = *len = dev->requested_blocks * 2048;
+	return 1;
+    }
+
     for (i = 0; i < dev->requested_blocks; i++) {
 	ret = cdrom_readsector_raw(dev->drv, dev->buffer + data_pos,
 				   dev->sector_pos + i, msf, type, flags, &temp_len);
@@ -1420,6 +1430,8 @@ scsi_cdrom_command(scsi_common_t *sc, uint8_t *cdb)
 
     memcpy(dev->current_cdb, cdb, 12);
 
+    disk_trace_cmd_start(DTRACE_CDROM, dev->id);
+
     if (cdb[0] != 0) {
 	scsi_cdrom_log("CD-ROM %i: Command 0x%02X, Sense Key %02X, Asc %02X, Ascq %02X, Unit attention: %i\n",
 		  dev->id, cdb[0], scsi_cdrom_sense_key, scsi_cdrom_asc, scsi_cdrom_ascq, dev->unit_attention);
@@ -70,6 +70,7 @@
 #define GPCMD_SEEK_10				0x2b
 #define GPCMD_WRITE_AND_VERIFY_10		0x2e
 #define GPCMD_VERIFY_10				0x2f
+#define GPCMD_SYNCHRONIZE_CACHE			0x35
 #define GPCMD_READ_BUFFER			0x3c
 #define GPCMD_WRITE_SAME_10			0x41
 #define GPCMD_READ_SUBCHANNEL			0x42
@@ -142,6 +143,7 @@
 /* SCSI Sense Keys */
 #define SENSE_NONE		0
 #define SENSE_NOT_READY		2
+#define SENSE_MEDIUM_ERROR	3
 #define SENSE_ILLEGAL_REQUEST	5
 #define SENSE_UNIT_ATTENTION	6
 
@@ -149,6 +151,7 @@
 #define ASC_NONE			0x00
 #define ASC_AUDIO_PLAY_OPERATION	0x00
 #define ASC_NOT_READY			0x04
+#define ASC_WRITE_ERROR			0x0c
 #define ASC_ILLEGAL_OPCODE		0x20
 #define ASC_LBA_OUT_OF_RANGE		0x21
 #define	ASC_INV_FIELD_IN_CMD_PACKET	0x24
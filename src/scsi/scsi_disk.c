@@ -25,6 +25,7 @@
 #include "../nvr.h"
 #include "../piix.h"
 #include "../disk/hdd.h"
+#include "../disk/disk_trace.h"
 #include "../disk/hdc.h"
 #include "scsi_device.h"
 #include "../disk/hdc_ide.h"
@@ -38,6 +39,8 @@
 #define scsi_disk_asc dev->sense[12]
 #define scsi_disk_ascq dev->sense[13]
 
+#define SCSI_DISK_BUF_KEEP	262144		/* larger buffers are freed after use */
+
 
 /* Table of all SCSI commands and their flags, needed for the new disc change / not ready handler. */
 const uint8_t scsi_disk_command_flags[0x100] = {
@@ -73,7 +76,9 @@ const uint8_t scsi_disk_command_flags[0x100] = {
     0, 0,
     IMPLEMENTED | CHECK_READY,					/* 0x2E */
     IMPLEMENTED | CHECK_READY | NONDATA | SCSI_ONLY,		/* 0x2F */
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0,
+    IMPLEMENTED | CHECK_READY | NONDATA,			/* 0x35 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
     0,
     IMPLEMENTED | CHECK_READY,					/* 0x41 */
     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
@@ -105,6 +110,7 @@ const uint8_t scsi_disk_command_flags[0x100] = {
 
 uint64_t scsi_disk_mode_sense_page_flags = (GPMODEP_FORMAT_DEVICE_PAGE |
 					    GPMODEP_RIGID_DISK_PAGE |
+					    GPMODEP_CACHING_PAGE |
 					    GPMODEP_UNK_VENDOR_PAGE |
 					    GPMODEP_ALL_PAGES);
 
@@ -112,12 +118,14 @@ uint64_t scsi_disk_mode_sense_page_flags = (GPMODEP_FORMAT_DEVICE_PAGE |
 static const mode_sense_pages_t scsi_disk_mode_sense_pages_default =
 {	{	[GPMODE_FORMAT_DEVICE_PAGE] = {	GPMODE_FORMAT_DEVICE_PAGE, 0x16, 0,    1, 0,  1, 0, 1, 0, 1, 1, 0, 2, 0, 0, 0, 0, 0, 0, 0,    0, 0, 0, 0 },
 		[GPMODE_RIGID_DISK_PAGE   ] = {	GPMODE_RIGID_DISK_PAGE, 0x16, 0, 0x10, 0, 64, 0, 0, 0, 0, 0, 0, 0, 200, 0xff, 0xff, 0xff, 0, 0, 0, 0x15, 0x18, 0, 0 },
+		[GPMODE_CACHING_PAGE      ] = {	GPMODE_CACHING_PAGE, 0x0a, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
 		[GPMODE_UNK_VENDOR_PAGE   ] = {	0xB0, 0x16, '8', '6', 'B', 'o', 'x', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ' }
 }	};
 
 static const mode_sense_pages_t scsi_disk_mode_sense_pages_changeable =
 {	{	[GPMODE_FORMAT_DEVICE_PAGE] = {	GPMODE_FORMAT_DEVICE_PAGE, 0x16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
 		[GPMODE_RIGID_DISK_PAGE   ] = {	GPMODE_RIGID_DISK_PAGE, 0x16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+		[GPMODE_CACHING_PAGE      ] = {	GPMODE_CACHING_PAGE, 0x0a, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
 		[GPMODE_UNK_VENDOR_PAGE   ] = {	0xB0, 0x16, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }
 }	};
 
@@ -227,6 +235,10 @@ scsi_disk_mode_sense_read(scsi_disk_t *dev, uint8_t page_control, uint8_t page,
 				return (dev->drv->spt + 1) & 0xff;
 		}
 		break;
+    } else if ((page == GPMODE_CACHING_PAGE) && (pos == 2) && (page_control != 1)) {
+	/* WCE follows the host write cache, so the guest knows to
+	   synchronize it; it is not changeable. */
+	return hdd_image_get_write_cache(dev->id) ? 0x04 : 0x00;
     } else switch (page_control) {
 	case 0:
 	case 3:
@@ -294,6 +306,7 @@ scsi_disk_command_common(scsi_disk_t *dev)
 static void
 scsi_disk_command_complete(scsi_disk_t *dev)
 {
+    disk_trace_cmd_end(DTRACE_HDD, dev->id);
     ui_sb_update_icon(SB_HDD | dev->drv->bus, 0);
     dev->packet_status = PHASE_COMPLETE;
     scsi_disk_command_common(dev);
@@ -358,6 +371,7 @@ scsi_disk_set_phase(scsi_disk_t *dev, uint8_t phase)
 static void
 scsi_disk_cmd_error(scsi_disk_t *dev)
 {
+    disk_trace_cmd_end(DTRACE_HDD, dev->id);
     scsi_disk_set_phase(dev, SCSI_PHASE_STATUS);
     dev->error = ((scsi_disk_sense_key & 0xf) << 4) | ABRT_ERR;
     dev->status = READY_STAT | ERR_STAT;
@@ -422,6 +436,16 @@ scsi_disk_invalid_field_pl(scsi_disk_t *dev)
 }
 
 
+static void
+scsi_disk_write_error(scsi_disk_t *dev)
+{
+    scsi_disk_sense_key = SENSE_MEDIUM_ERROR;
+    scsi_disk_asc = ASC_WRITE_ERROR;
+    scsi_disk_ascq = 0;
+    scsi_disk_cmd_error(dev);
+}
+
+
 static void
 scsi_disk_data_phase_error(scsi_disk_t *dev)
 {
@@ -537,22 +561,33 @@ scsi_disk_set_buf_len(scsi_disk_t *dev, int32_t *BufLen, int32_t *src_len)
 }
 
 
+/* The buffer stays with the device from one command to the next, and
+   only grows when a command needs more than it has. */
 static void
 scsi_disk_buf_alloc(scsi_disk_t *dev, uint32_t len)
 {
+    uint8_t *buf;
+
     scsi_disk_log("SCSI HD %i: Allocated buffer length: %i\n", dev->id, len);
-    if (!dev->temp_buffer)
-	dev->temp_buffer = (uint8_t *) malloc(len);
+    if (len > dev->buf_size) {
+	buf = (uint8_t *) realloc(dev->temp_buffer, len);
+	if (buf == NULL)
+		fatal("SCSI HD %i: Unable to allocate %u bytes of buffer\n", dev->id, len);
+	dev->temp_buffer = buf;
+	dev->buf_size = len;
+    }
 }
 
 
+/* Only give back a buffer left large by a big transfer. */
 static void
 scsi_disk_buf_free(scsi_disk_t *dev)
 {
-    if (dev->temp_buffer) {
+    if (dev->temp_buffer && (dev->buf_size > SCSI_DISK_BUF_KEEP)) {
 	scsi_disk_log("SCSI HD %i: Freeing buffer...\n", dev->id);
 	free(dev->temp_buffer);
 	dev->temp_buffer = NULL;
+	dev->buf_size = 0;
     }
 }
 
@@ -589,6 +624,8 @@ scsi_disk_command(scsi_common_t *sc, uint8_t *cdb)
 
     memcpy(dev->current_cdb, cdb, 12);
 
+    disk_trace_cmd_start(DTRACE_HDD, dev->id);
+
     if (cdb[0] != 0) {
 	scsi_disk_log("SCSI HD %i: Command 0x%02X, Sense Key %02X, Asc %02X, Ascq %02X\n",
 		    dev->id, cdb[0], scsi_disk_sense_key, scsi_disk_asc, scsi_disk_ascq);
@@ -1013,6 +1050,15 @@ atapi_out:
 		scsi_disk_command_complete(dev);
 		break;
 
+	case GPCMD_SYNCHRONIZE_CACHE:
+		if (! hdd_image_flush(dev->id)) {
+			scsi_disk_write_error(dev);
+			return;
+		}
+		scsi_disk_set_phase(dev, SCSI_PHASE_STATUS);
+		scsi_disk_command_complete(dev);
+		break;
+
 	case GPCMD_SEEK_6:
 	case GPCMD_SEEK_10:
 		switch(cdb[0]) {
@@ -1223,6 +1269,9 @@ scsi_disk_hard_reset(void)
 		if (! hdd_image_load(c))
 			continue;
 
+		/* The caching mode page reports the write cache. */
+		hdd_image_report_write_cache(c, 1);
+
 		if (!hdd[c].priv) {
 			hdd[c].priv = (scsi_disk_t *) malloc(sizeof(scsi_disk_t));
 			memset(hdd[c].priv, 0, sizeof(scsi_disk_t));
@@ -1265,6 +1314,8 @@ scsi_disk_close(void)
 		dev = hdd[c].priv;
 
 		if (dev) {
+			if (dev->temp_buffer)
+				free(dev->temp_buffer);
 			free(dev);
 			hdd[c].priv = NULL;
 		}
@@ -40,6 +40,8 @@ typedef struct {
 	     packet_len, pos;
 
     double callback;
+
+    uint32_t buf_size;		/* allocated size of temp_buffer */
 } scsi_disk_t;
 
 
@@ -49,6 +49,8 @@
 
 #define NCR53C8XX_ROM	L"roms/scsi/ncr53c8xx/NCR307.BIN"
 
+#define NCR_ICACHE_SIZE	  256	/* SCRIPTS instructions, must be a power of 2 */
+
 #define CHIP_810	  0x01
 #define CHIP_825	  0x03
 #define CHIP_875	  0x0f
@@ -185,6 +187,17 @@ typedef struct ncr53c8xx_request {
     int out;
 } ncr53c8xx_request;
 
+/* A SCRIPTS instruction as fetched, tagged with its address. An entry
+   stamped with the current epoch is known to match memory; older ones
+   are compared against memory once before being used again. */
+typedef struct {
+    uint32_t addr;
+    uint32_t epoch;
+    uint32_t w[3];	/* opcode, operand and memory move destination */
+    uint8_t len;	/* 4 for an empty opcode, 12 for a memory move, 8 otherwise */
+    uint8_t valid;
+} ncr53c8xx_insn_t;
+
 typedef enum
 {
         SCSI_STATE_SEND_COMMAND,
@@ -302,6 +315,11 @@ typedef struct {
     uint32_t adder;
 
     pc_timer_t timer;
+
+    ncr53c8xx_insn_t icache[NCR_ICACHE_SIZE];
+    uint32_t icache_epoch;
+    uint32_t cmd_insns;		/* SCRIPTS instructions run for the current command */
+    uint64_t icache_hits, icache_misses;
 } ncr53c8xx_t;
 
 
@@ -421,6 +439,8 @@ ncr53c8xx_soft_reset(ncr53c8xx_t *dev)
     dev->slpar = 0;
     dev->sstop = 1;
     dev->gpcntl = 0x0f;
+    for (i = 0; i < NCR_ICACHE_SIZE; i++)
+	dev->icache[i].valid = 0;
 #ifdef USE_NVRAM
     dev->nvram_t = dev->nvram_index = 0;
 #endif
@@ -457,6 +477,35 @@ ncr53c8xx_read(ncr53c8xx_t *dev, uint32_t addr, uint8_t *buf, uint32_t len)
 }
 
 
+/* Drop cached instructions overlapping a range SCRIPTS wrote to. */
+static void
+ncr53c8xx_icache_invalidate(ncr53c8xx_t *dev, uint32_t addr, uint32_t len)
+{
+    ncr53c8xx_insn_t *e;
+    int i;
+
+    for (i = 0; i < NCR_ICACHE_SIZE; i++) {
+	e = &dev->icache[i];
+	if (e->valid && ((e->addr - addr) < len || (addr - e->addr) < e->len))
+		e->valid = 0;
+    }
+}
+
+
+/* Have every cached instruction checked against memory before its next
+   use; called whenever anything other than SCRIPTS may have run. */
+static void
+ncr53c8xx_icache_stale(ncr53c8xx_t *dev)
+{
+    int i;
+
+    if (++dev->icache_epoch == 0) {
+	for (i = 0; i < NCR_ICACHE_SIZE; i++)
+		dev->icache[i].valid = 0;
+    }
+}
+
+
 static void
 ncr53c8xx_write(ncr53c8xx_t *dev, uint32_t addr, uint8_t *buf, uint32_t len)
 {
@@ -471,6 +520,7 @@ ncr53c8xx_write(ncr53c8xx_t *dev, uint32_t addr, uint8_t *buf, uint32_t len)
 	} else {
 		ncr53c8xx_log("NCR 810: Writing to memory address %08X\n", addr);
         	DMAPageWrite(addr, buf, len);
+		ncr53c8xx_icache_invalidate(dev, addr, len);
 	}
 }
 
@@ -485,6 +535,49 @@ read_dword(ncr53c8xx_t *dev, uint32_t addr)
 }
 
 
+/* Fetch the instruction at addr, from the cache if memory still
+   holds the same one. */
+static ncr53c8xx_insn_t *
+ncr53c8xx_fetch(ncr53c8xx_t *dev, uint32_t addr)
+{
+    ncr53c8xx_insn_t *e = &dev->icache[(addr >> 2) & (NCR_ICACHE_SIZE - 1)];
+    uint32_t w[3];
+
+    if (e->valid && (e->addr == addr)) {
+	if (e->epoch == dev->icache_epoch) {
+		dev->icache_hits++;
+		return e;
+	}
+
+	DMAPageRead(addr, (uint8_t *)w, e->len);
+	if (!memcmp(w, e->w, e->len)) {
+		e->epoch = dev->icache_epoch;
+		dev->icache_hits++;
+		return e;
+	}
+    }
+
+    dev->icache_misses++;
+
+    e->w[0] = read_dword(dev, addr);
+    e->w[1] = e->w[2] = 0;
+    if (!e->w[0])
+	e->len = 4;
+    else if (((e->w[0] >> 30) == 3) && !(e->w[0] & (1 << 29)))
+	e->len = 12;
+    else
+	e->len = 8;
+    if (e->len > 4)
+	DMAPageRead(addr + 4, (uint8_t *)&e->w[1], e->len - 4);
+
+    e->addr = addr;
+    e->epoch = dev->icache_epoch;
+    e->valid = 1;
+
+    return e;
+}
+
+
 static
 void do_irq(ncr53c8xx_t *dev, int level)
 {
@@ -620,6 +713,7 @@ ncr53c8xx_command_complete(void *priv, uint32_t status)
 	
     out = (dev->sstat1 & PHASE_MASK) == PHASE_DO;
     ncr53c8xx_log("(ID=%02i LUN=%02i) SCSI Command 0x%02x: Command complete status=%d\n", dev->current->tag, dev->current_lun, dev->last_command, (int)status);
+    ncr53c8xx_log("(ID=%02i LUN=%02i) SCSI Command 0x%02x: %u SCRIPTS instructions, cache %" PRIu64 " hits, %" PRIu64 " misses\n", dev->current->tag, dev->current_lun, dev->last_command, dev->cmd_insns, dev->icache_hits, dev->icache_misses);
     dev->status = status;
     dev->command_complete = 2;	
     if (dev->waiting && dev->dbc != 0) {
@@ -728,6 +822,7 @@ ncr53c8xx_do_command(ncr53c8xx_t *dev, uint8_t id)
     }
     dev->sfbr = buf[0];
     dev->command_complete = 0;
+    dev->cmd_insns = 0;
 
     sd = &scsi_devices[id];
     if (!scsi_device_present(sd)) {
@@ -1009,6 +1104,7 @@ ncr53c8xx_memcpy(ncr53c8xx_t *dev, uint32_t dest, uint32_t src, int count)
 static void
 ncr53c8xx_process_script(ncr53c8xx_t *dev)
 {
+    ncr53c8xx_insn_t *e;
     uint32_t insn, addr, id, buf[2], dest;
     int opcode, insn_processed = 0, reg, operator, cond, jmp, n, i, c;
     int32_t offset;
@@ -1018,9 +1114,15 @@ ncr53c8xx_process_script(ncr53c8xx_t *dev)
 #endif
 
     dev->sstop = 0;
+
+    /* The guest has run since the last call and may have changed the
+       SCRIPTS; within this call only SCRIPTS itself writes to memory. */
+    ncr53c8xx_icache_stale(dev);
 again:
     insn_processed++;
-    insn = read_dword(dev, dev->dsp);
+    dev->cmd_insns++;
+    e = ncr53c8xx_fetch(dev, dev->dsp);
+    insn = e->w[0];
     if (!insn) {
 	/* If we receive an empty opcode increment the DSP by 4 bytes
 	   instead of 8 and execute the next opcode at that location */
@@ -1032,7 +1134,8 @@ again:
 		return;
 	}
     }
-    addr = read_dword(dev, dev->dsp + 4);
+    addr = e->w[1];
+    dest = e->w[2];
     ncr53c8xx_log("SCRIPTS dsp=%08x opcode %08x arg %08x\n", dev->dsp, insn, addr);
     dev->dsps = addr;
     dev->dcmd = insn >> 24;
@@ -1335,7 +1438,6 @@ again:
 			/* ??? The docs imply the destination address is loaded into
 			   the TEMP register.  However the Linux drivers rely on
 			   the value being presrved.  */
-			dest = read_dword(dev, dev->dsp);
 			dev->dsp += 4;
 			ncr53c8xx_memcpy(dev, dest, addr, insn & 0xffffff);
 		} else {
@@ -1356,6 +1458,7 @@ again:
 				for (i = 0; i < n; i++)
 					data[i] = ncr53c8xx_reg_readb(dev, reg + i);
 				DMAPageWrite(addr, data, n);
+				ncr53c8xx_icache_invalidate(dev, addr, n);
 			}
 		}
 		break;
@@ -1722,6 +1825,7 @@ ncr53c8xx_reg_writeb(ncr53c8xx_t *dev, uint32_t offset, uint8_t val)
 	case 0x2f: /* DSP[24:31] */
 		dev->dsp &= 0x00ffffff;
 		dev->dsp |= val << 24;
+		ncr53c8xx_icache_stale(dev);
 		if (!(dev->dmode & NCR_DMODE_MAN) && dev->sstop)
 			ncr53c8xx_execute_script(dev);
 		break;
@@ -663,23 +663,34 @@ x54x_mbi(x54x_t *dev)
 }
 
 
-static void
-x54x_rd_sge(x54x_t *dev, int Is24bit, uint32_t Address, SGE32 *SG)
+/* Read up to X54X_SGE_BATCH entries of a list with one DMA read. */
+static int
+x54x_rd_sge_list(x54x_t *dev, int Is24bit, uint32_t Address, uint32_t Length, SGE32 *SG)
 {
-    SGE SGE24;
+    SGE SGE24[X54X_SGE_BATCH];
+    uint32_t SGEntryLength = (Is24bit ? sizeof(SGE) : sizeof(SGE32));
+    int i, n;
+
+    n = (Length + SGEntryLength - 1) / SGEntryLength;
+    if (n > X54X_SGE_BATCH)
+	n = X54X_SGE_BATCH;
+    if (n <= 0)
+	return(0);
 
     if (Is24bit) {
-	DMAPageRead(Address, (uint8_t *)&SGE24, sizeof(SGE));
-	x54x_add_to_period(dev, sizeof(SGE));
+	DMAPageRead(Address, (uint8_t *)SGE24, n * sizeof(SGE));
+	x54x_add_to_period(dev, n * sizeof(SGE));
 
-	/* Convert the 24-bit entries into 32-bit entries. */
-	x54x_log("Read S/G block: %06X, %06X\n", SGE24.Segment, SGE24.SegmentPointer);
-	SG->Segment = ADDR_TO_U32(SGE24.Segment);
-	SG->SegmentPointer = ADDR_TO_U32(SGE24.SegmentPointer);
+	for (i = 0; i < n; i++) {
+		SG[i].Segment = ADDR_TO_U32(SGE24[i].Segment);
+		SG[i].SegmentPointer = ADDR_TO_U32(SGE24[i].SegmentPointer);
+	}
     } else {
-	DMAPageRead(Address, (uint8_t *)SG, sizeof(SGE32));		
-	x54x_add_to_period(dev, sizeof(SGE32));
+	DMAPageRead(Address, (uint8_t *)SG, n * sizeof(SGE32));
+	x54x_add_to_period(dev, n * sizeof(SGE32));
     }
+
+    return(n);
 }
 
 
@@ -688,8 +699,9 @@ x54x_get_length(x54x_t *dev, Req_t *req, int Is24bit)
 {
     uint32_t DataPointer, DataLength;
     uint32_t SGEntryLength = (Is24bit ? sizeof(SGE) : sizeof(SGE32));
-    SGE32 SGBuffer;
+    SGE32 SGBuffer[X54X_SGE_BATCH];
     uint32_t DataToTransfer = 0, i = 0;
+    int j, n;
 
     if (Is24bit) {
 	DataPointer = ADDR_TO_U32(req->CmdBlock.old.DataPointer);
@@ -708,10 +720,13 @@ x54x_get_length(x54x_t *dev, Req_t *req, int Is24bit)
     if (req->CmdBlock.common.ControlByte != 0x03) {
 	if (req->CmdBlock.common.Opcode == SCATTER_GATHER_COMMAND ||
 	    req->CmdBlock.common.Opcode == SCATTER_GATHER_COMMAND_RES) {
-		for (i = 0; i < DataLength; i += SGEntryLength) {
-			x54x_rd_sge(dev, Is24bit, DataPointer + i, &SGBuffer);
+		for (i = 0; i < DataLength; i += (n * SGEntryLength)) {
+			n = x54x_rd_sge_list(dev, Is24bit, DataPointer + i, DataLength - i, SGBuffer);
+			if (n == 0)
+				break;
 
-			DataToTransfer += SGBuffer.Segment;
+			for (j = 0; j < n; j++)
+				DataToTransfer += SGBuffer[j].Segment;
 		}
 		return(DataToTransfer);
 	} else if (req->CmdBlock.common.Opcode == SCSI_INITIATOR_COMMAND ||
@@ -763,10 +778,11 @@ x54x_buf_dma_transfer(x54x_t *dev, Req_t *req, int Is24bit, int TransferLength,
     uint32_t SGEntryLength = (Is24bit ? sizeof(SGE) : sizeof(SGE32));
     uint32_t Address, i;
     int32_t BufLen = scsi_devices[req->TargetID].buffer_length;
+    uint8_t *buf = scsi_devices[req->TargetID].sc->temp_buffer;
     uint8_t read_from_host = (dir && ((req->CmdBlock.common.ControlByte == CCB_DATA_XFER_OUT) || (req->CmdBlock.common.ControlByte == 0x00)));
     uint8_t write_to_host = (!dir && ((req->CmdBlock.common.ControlByte == CCB_DATA_XFER_IN) || (req->CmdBlock.common.ControlByte == 0x00)));
-    int sg_pos = 0;
-    SGE32 SGBuffer;
+    int sg_pos = 0, j, n;
+    SGE32 SGBuffer[X54X_SGE_BATCH];
     uint32_t DataToTransfer = 0;
 
     if (Is24bit) {
@@ -786,30 +802,34 @@ x54x_buf_dma_transfer(x54x_t *dev, Req_t *req, int Is24bit, int TransferLength,
 		/* If the control byte is 0x00, it means that the transfer direction is set up by the SCSI command without
 		   checking its length, so do this procedure for both no read/write commands. */
 		if ((DataLength > 0) && (req->CmdBlock.common.ControlByte < 0x03)) {
-			for (i = 0; i < DataLength; i += SGEntryLength) {
-				x54x_rd_sge(dev, Is24bit, DataPointer + i, &SGBuffer);
+			for (i = 0; i < DataLength; i += (n * SGEntryLength)) {
+				n = x54x_rd_sge_list(dev, Is24bit, DataPointer + i, DataLength - i, SGBuffer);
+				if (n == 0)
+					break;
 
-				Address = SGBuffer.SegmentPointer;
-				DataToTransfer = MIN((int) SGBuffer.Segment, BufLen);
+				for (j = 0; j < n; j++) {
+					Address = SGBuffer[j].SegmentPointer;
+					DataToTransfer = MIN((int) SGBuffer[j].Segment, BufLen);
 
-				if (read_from_host && DataToTransfer) {
-					x54x_log("Reading S/G segment %i: length %i, pointer %08X\n", i, DataToTransfer, Address);
-					DMAPageRead(Address, &(scsi_devices[req->TargetID].sc->temp_buffer[sg_pos]), DataToTransfer);
-				}
-				else if (write_to_host && DataToTransfer) {
-					x54x_log("Writing S/G segment %i: length %i, pointer %08X\n", i, DataToTransfer, Address);
-					DMAPageWrite(Address, &(scsi_devices[req->TargetID].sc->temp_buffer[sg_pos]), DataToTransfer);
-				}
-				else
-					x54x_log("No action on S/G segment %i: length %i, pointer %08X\n", i, DataToTransfer, Address);
+					if (read_from_host && DataToTransfer) {
+						x54x_log("Reading S/G segment %i: length %i, pointer %08X\n", i, DataToTransfer, Address);
+						DMAPageRead(Address, &buf[sg_pos], DataToTransfer);
+					}
+					else if (write_to_host && DataToTransfer) {
+						x54x_log("Writing S/G segment %i: length %i, pointer %08X\n", i, DataToTransfer, Address);
+						DMAPageWrite(Address, &buf[sg_pos], DataToTransfer);
+					}
+					else
+						x54x_log("No action on S/G segment %i: length %i, pointer %08X\n", i, DataToTransfer, Address);
 
-				sg_pos += SGBuffer.Segment;
+					sg_pos += SGBuffer[j].Segment;
 
-				BufLen -= SGBuffer.Segment;
-				if (BufLen < 0)
-					BufLen = 0;
+					BufLen -= SGBuffer[j].Segment;
+					if (BufLen < 0)
+						BufLen = 0;
 
-				x54x_log("After S/G segment done: %i, %i\n", sg_pos, BufLen);
+					x54x_log("After S/G segment done: %i, %i\n", sg_pos, BufLen);
+				}
 			}
 		}
 	} else if ((req->CmdBlock.common.Opcode == SCSI_INITIATOR_COMMAND) ||
@@ -818,9 +838,9 @@ x54x_buf_dma_transfer(x54x_t *dev, Req_t *req, int Is24bit, int TransferLength,
 
 		if ((DataLength > 0) && (BufLen > 0) && (req->CmdBlock.common.ControlByte < 0x03)) {
 			if (read_from_host)
-				DMAPageRead(Address, scsi_devices[req->TargetID].sc->temp_buffer, MIN(BufLen, (int) DataLength));
+				DMAPageRead(Address, buf, MIN(BufLen, (int) DataLength));
 			else if (write_to_host)
-				DMAPageWrite(Address, scsi_devices[req->TargetID].sc->temp_buffer, MIN(BufLen, (int) DataLength));
+				DMAPageWrite(Address, buf, MIN(BufLen, (int) DataLength));
 		}
 	}
     }
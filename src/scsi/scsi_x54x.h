@@ -362,6 +362,8 @@ typedef struct {
 } SGE;
 #pragma pack(pop)
 
+#define		X54X_SGE_BATCH		64	/* S/G entries read per DMA transfer */
+
 #define		X54X_CDROM_BOOT		 1
 #define		X54X_32BIT		 2
 #define		X54X_LBA_BIOS		 4
@@ -29,6 +29,7 @@
 #include "../device.h"
 #include "../plat.h"
 #include "../plat_midi.h"
+#include "sound.h"
 #include "midi.h"
 #include "midi_system.h"
 #ifdef USE_FLUIDSYNTH
@@ -42,9 +43,14 @@
 #define SYSEX_SIZE 1024
 #define RAWBUF 1024
 
+/* Blocks without an underrun before the block size is lowered again. */
+#define MIDI_BLOCK_STABLE 100
+
 int midi_device_current = 0;
 static int midi_device_last = 0;
 
+uint32_t midi_underruns = 0, midi_overruns = 0;
+
 
 typedef struct
 {
@@ -166,6 +172,41 @@ midi_device_init()
 }
 
 
+void
+midi_block_init(midi_block_t *block, int min, int max)
+{
+    block->min = min;
+    block->max = max;
+    block->segments = max;
+    block->stable = 0;
+}
+
+
+void
+midi_block_submit(midi_block_t *block, void *buf, uint32_t size)
+{
+    int queued = sound_backend_queued(SOUND_STREAM_MIDI);
+
+    if (queued == 0) {
+	/* The output ran dry - buffer more from now on. */
+	midi_underruns++;
+	block->segments <<= 1;
+	if (block->segments > block->max)
+		block->segments = block->max;
+	block->stable = 0;
+    } else if (queued >= sound_queue_depth) {
+	/* No free buffer, so this block will be dropped. */
+	midi_overruns++;
+    } else if ((queued > 0) && (++block->stable >= MIDI_BLOCK_STABLE)) {
+	if (block->segments > block->min)
+		block->segments--;
+	block->stable = 0;
+    }
+
+    givealbuffer_midi(buf, size);
+}
+
+
 void
 midi_init(midi_device_t* device)
 {
@@ -23,6 +23,20 @@ typedef struct midi_device_t
         int (*write)(uint8_t val);
 } midi_device_t;
 
+/*Output blocks of the software synths (MT-32, FluidSynth). A block is handed
+  to the audio output every 'segments' render segments; the count grows when
+  the output ran dry and shrinks again after a long run without underruns.*/
+typedef struct midi_block_t
+{
+        int segments, min, max;
+        int stable;
+} midi_block_t;
+
+extern uint32_t midi_underruns, midi_overruns;
+
+void midi_block_init(midi_block_t *block, int min, int max);
+void midi_block_submit(midi_block_t *block, void *buf, uint32_t size);
+
 void midi_init(midi_device_t* device);
 void midi_close();
 void midi_write(uint8_t val);
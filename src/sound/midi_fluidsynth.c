@@ -107,6 +107,9 @@ typedef struct fluidsynth
         float* buffer;
         int16_t* buffer_int16;
         int midi_pos;
+        /* Segments due (counted by fluidsynth_poll) and rendered (by the thread). */
+        volatile uint32_t segments_due, segments_done;
+        midi_block_t block;
 
 	int on;
 } fluidsynth_t;
@@ -125,6 +128,7 @@ void fluidsynth_poll(void)
         if (data->midi_pos == 48000/RENDER_RATE)
         {
                 data->midi_pos = 0;
+                data->segments_due++;
                 thread_set_event(data->event);
         }
 }
@@ -142,32 +146,38 @@ static void fluidsynth_thread(void *param)
                 thread_wait_event(data->event, -1);
                 thread_reset_event(data->event);
 
-		if (sound_is_float)
-		{
-			float *buf = (float*)((uint8_t*)data->buffer + buf_pos);
-			memset(buf, 0, buf_size);
-	                if (data->synth)
-        	                f_fluid_synth_write_float(data->synth, buf_size/(2 * sizeof(float)), buf, 0, 2, buf, 1, 2);
-			buf_pos += buf_size;
-			if (buf_pos >= data->buf_size)
+                /* Wakeups can be merged when the host is busy, so catch up
+                   on every segment that has become due since the last one. */
+                while (data->on && (data->segments_done != data->segments_due))
+                {
+			if (sound_is_float)
 			{
-       		                givealbuffer_midi(data->buffer, data->buf_size / sizeof(float));
-				buf_pos = 0;
+				float *buf = (float*)((uint8_t*)data->buffer + buf_pos);
+				memset(buf, 0, buf_size);
+		                if (data->synth)
+        		                f_fluid_synth_write_float(data->synth, buf_size/(2 * sizeof(float)), buf, 0, 2, buf, 1, 2);
+				buf_pos += buf_size;
+				if (buf_pos >= (buf_size * data->block.segments))
+				{
+       			                midi_block_submit(&data->block, data->buffer, buf_pos / sizeof(float));
+					buf_pos = 0;
+				}
 			}
-		}
-		else
-		{
-			int16_t *buf = (int16_t*)((uint8_t*)data->buffer_int16 + buf_pos);
-			memset(buf, 0, buf_size);
-	                if (data->synth)
-        	                f_fluid_synth_write_s16(data->synth, buf_size/(2 * sizeof(int16_t)), buf, 0, 2, buf, 1, 2);
-			buf_pos += buf_size;
-			if (buf_pos >= data->buf_size)
+			else
 			{
-       		                givealbuffer_midi(data->buffer_int16, data->buf_size / sizeof(int16_t));
-				buf_pos = 0;
+				int16_t *buf = (int16_t*)((uint8_t*)data->buffer_int16 + buf_pos);
+				memset(buf, 0, buf_size);
+		                if (data->synth)
+        		                f_fluid_synth_write_s16(data->synth, buf_size/(2 * sizeof(int16_t)), buf, 0, 2, buf, 1, 2);
+				buf_pos += buf_size;
+				if (buf_pos >= (buf_size * data->block.segments))
+				{
+       			                midi_block_submit(&data->block, data->buffer_int16, buf_pos / sizeof(int16_t));
+					buf_pos = 0;
+				}
 			}
-		}
+			data->segments_done++;
+                }
         }
 }
 
@@ -321,6 +331,8 @@ void* fluidsynth_init(const device_t *info)
         midi_init(dev);
 
 	data->on = 1;
+	data->segments_due = data->segments_done = 0;
+	midi_block_init(&data->block, 2, BUFFER_SEGMENTS);
 
         data->start_event = thread_create_event();
 
@@ -94,6 +94,9 @@ static int buf_size = 0;
 static float* buffer = NULL;
 static int16_t* buffer_int16 = NULL;
 static int midi_pos = 0;
+/* Segments due (counted by mt32_poll) and rendered (by mt32_thread). */
+static volatile uint32_t segments_due = 0, segments_done = 0;
+static midi_block_t block;
 
 void mt32_stream(float* stream, int len)
 {
@@ -111,6 +114,7 @@ void mt32_poll()
         if (midi_pos == 48000/RENDER_RATE)
         {
                 midi_pos = 0;
+                segments_due++;
                 thread_set_event(event);
         }
 }
@@ -129,30 +133,36 @@ static void mt32_thread(void *param)
                 thread_wait_event(event, -1);
                 thread_reset_event(event);
 
-		if (sound_is_float)
-		{
-			buf = (float *) ((uint8_t*)buffer + buf_pos);
-			memset(buf, 0, bsize);
-			mt32_stream(buf, bsize / (2 * sizeof(float)));
-			buf_pos += bsize;
-			if (buf_pos >= buf_size)
+                /* Wakeups can be merged when the host is busy, so catch up
+                   on every segment that has become due since the last one. */
+                while (mt32_on && (segments_done != segments_due))
+                {
+			if (sound_is_float)
 			{
-				givealbuffer_midi(buffer, buf_size / sizeof(float));
-				buf_pos = 0;
+				buf = (float *) ((uint8_t*)buffer + buf_pos);
+				memset(buf, 0, bsize);
+				mt32_stream(buf, bsize / (2 * sizeof(float)));
+				buf_pos += bsize;
+				if (buf_pos >= (bsize * block.segments))
+				{
+					midi_block_submit(&block, buffer, buf_pos / sizeof(float));
+					buf_pos = 0;
+				}
 			}
-		}
-		else
-		{
-			buf16 = (int16_t *) ((uint8_t*)buffer_int16 + buf_pos);
-			memset(buf16, 0, bsize);
-			mt32_stream_int16(buf16, bsize / (2 * sizeof(int16_t)));
-			buf_pos += bsize;
-			if (buf_pos >= buf_size)
+			else
 			{
-				givealbuffer_midi(buffer_int16, buf_size / sizeof(int16_t));
-				buf_pos = 0;
+				buf16 = (int16_t *) ((uint8_t*)buffer_int16 + buf_pos);
+				memset(buf16, 0, bsize);
+				mt32_stream_int16(buf16, bsize / (2 * sizeof(int16_t)));
+				buf_pos += bsize;
+				if (buf_pos >= (bsize * block.segments))
+				{
+					midi_block_submit(&block, buffer_int16, buf_pos / sizeof(int16_t));
+					buf_pos = 0;
+				}
 			}
-		}
+			segments_done++;
+                }
         }
 }
 
@@ -216,6 +226,8 @@ void* mt32emu_init(wchar_t *control_rom, wchar_t *pcm_rom)
         midi_init(dev);
 
 	mt32_on = 1;
+	segments_due = segments_done = 0;
+	midi_block_init(&block, 2, BUFFER_SEGMENTS);
 
 	start_event = thread_create_event();
 
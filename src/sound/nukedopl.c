@@ -372,6 +372,12 @@ static void OPL3_EnvelopeCalc(struct opl3_slot *slot)
     Bit8u reset = 0;
     slot->eg_out = slot->eg_rout + (slot->reg_tl << 2)
                  + (slot->eg_ksl >> kslshift[slot->reg_ksl]) + *slot->trem;
+    // Keyed off at full attenuation: nothing below can change any state
+    if (!slot->key && slot->eg_gen == envelope_gen_num_release && slot->eg_rout == 0x1ff)
+    {
+        slot->pg_reset = 0;
+        return;
+    }
     if (slot->key && slot->eg_gen == envelope_gen_num_release)
     {
         reset = 1;
@@ -658,11 +664,12 @@ static void OPL3_SlotWriteE0(struct opl3_slot *slot, Bit8u data)
     {
         slot->reg_wf &= 0x03;
     }
+    slot->wf = envelope_sin[slot->reg_wf];
 }
 
 static void OPL3_SlotGenerate(struct opl3_slot *slot)
 {
-    slot->out = envelope_sin[slot->reg_wf](slot->pg_phase_out + *slot->mod, slot->eg_out);
+    slot->out = slot->wf(slot->pg_phase_out + *slot->mod, slot->eg_out);
 }
 
 static void OPL3_SlotCalcFB(struct opl3_slot *slot)
@@ -678,6 +685,14 @@ static void OPL3_SlotCalcFB(struct opl3_slot *slot)
     slot->prout = slot->out;
 }
 
+static void OPL3_SlotProcess(struct opl3_slot *slot)
+{
+    OPL3_SlotCalcFB(slot);
+    OPL3_EnvelopeCalc(slot);
+    OPL3_PhaseGenerate(slot);
+    OPL3_SlotGenerate(slot);
+}
+
 //
 // Channel
 //
@@ -1043,21 +1058,19 @@ static Bit16s OPL3_ClipSample(Bit32s sample)
     return (Bit16s)sample;
 }
 
+static void OPL3_UpdateTimers(struct opl3_chip *chip);
+
 void OPL3_Generate(struct opl3_chip *chip, Bit16s *buf)
 {
     Bit8u ii;
     Bit8u jj;
     Bit16s accm;
-    Bit8u shift = 0;
 
     buf[1] = OPL3_ClipSample(chip->mixbuff[1]);
 
     for (ii = 0; ii < 15; ii++)
     {
-        OPL3_SlotCalcFB(&chip->slot[ii]);
-        OPL3_EnvelopeCalc(&chip->slot[ii]);
-        OPL3_PhaseGenerate(&chip->slot[ii]);
-        OPL3_SlotGenerate(&chip->slot[ii]);
+        OPL3_SlotProcess(&chip->slot[ii]);
     }
 
     chip->mixbuff[0] = 0;
@@ -1073,20 +1086,14 @@ void OPL3_Generate(struct opl3_chip *chip, Bit16s *buf)
 
     for (ii = 15; ii < 18; ii++)
     {
-        OPL3_SlotCalcFB(&chip->slot[ii]);
-        OPL3_EnvelopeCalc(&chip->slot[ii]);
-        OPL3_PhaseGenerate(&chip->slot[ii]);
-        OPL3_SlotGenerate(&chip->slot[ii]);
+        OPL3_SlotProcess(&chip->slot[ii]);
     }
 
     buf[0] = OPL3_ClipSample(chip->mixbuff[0]);
 
     for (ii = 18; ii < 33; ii++)
     {
-        OPL3_SlotCalcFB(&chip->slot[ii]);
-        OPL3_EnvelopeCalc(&chip->slot[ii]);
-        OPL3_PhaseGenerate(&chip->slot[ii]);
-        OPL3_SlotGenerate(&chip->slot[ii]);
+        OPL3_SlotProcess(&chip->slot[ii]);
     }
 
     chip->mixbuff[1] = 0;
@@ -1102,12 +1109,21 @@ void OPL3_Generate(struct opl3_chip *chip, Bit16s *buf)
 
     for (ii = 33; ii < 36; ii++)
     {
-        OPL3_SlotCalcFB(&chip->slot[ii]);
-        OPL3_EnvelopeCalc(&chip->slot[ii]);
-        OPL3_PhaseGenerate(&chip->slot[ii]);
-        OPL3_SlotGenerate(&chip->slot[ii]);
+        OPL3_SlotProcess(&chip->slot[ii]);
     }
 
+    OPL3_UpdateTimers(chip);
+}
+
+//
+// Advance the chip-wide counters and apply buffered register writes; the
+// part of OPL3_Generate that does not depend on the slots
+//
+
+static void OPL3_UpdateTimers(struct opl3_chip *chip)
+{
+    Bit8u shift = 0;
+
     if ((chip->timer & 0x3f) == 0x3f)
     {
         chip->tremolopos = (chip->tremolopos + 1) % 210;
@@ -1161,6 +1177,11 @@ void OPL3_Generate(struct opl3_chip *chip, Bit16s *buf)
 
     chip->eg_state ^= 1;
 
+    if (chip->quiet < 0xff)
+    {
+        chip->quiet++;
+    }
+
     while (chip->writebuf[chip->writebuf_cur].time <= chip->writebuf_samplecnt)
     {
         if (!(chip->writebuf[chip->writebuf_cur].reg & 0x200))
@@ -1175,6 +1196,67 @@ void OPL3_Generate(struct opl3_chip *chip, Bit16s *buf)
     chip->writebuf_samplecnt++;
 }
 
+//
+// Idle detection
+//
+// With every slot keyed off at full attenuation, no frequency, no rhythm mode
+// and no register write for two samples, each slot outputs a constant 0 or -1
+// given by its (frozen) phase, so the mix repeats the last sample exactly.
+// Only the chip-wide counters and the noise generator still move.
+//
+
+static Bit8u OPL3_CheckIdle(struct opl3_chip *chip)
+{
+    struct opl3_slot *slot;
+    Bit16s fbmod;
+    Bit8u ii;
+
+    if (chip->quiet < 2 || (chip->rhy & 0x20)
+     || (chip->writebuf[chip->writebuf_cur].reg & 0x200))
+    {
+        return 0;
+    }
+    if (chip->samples[0] != chip->oldsamples[0] || chip->samples[1] != chip->oldsamples[1]
+     || chip->samples[0] != OPL3_ClipSample(chip->mixbuff[0])
+     || chip->samples[1] != OPL3_ClipSample(chip->mixbuff[1]))
+    {
+        return 0;
+    }
+    for (ii = 0; ii < 36; ii++)
+    {
+        slot = &chip->slot[ii];
+        if (slot->key || slot->eg_gen != envelope_gen_num_release || slot->eg_rout != 0x1ff
+         || slot->channel->f_num || slot->prout != slot->out
+         || slot->pg_phase_out != (Bit16u)(slot->pg_phase >> 9))
+        {
+            return 0;
+        }
+        fbmod = 0;
+        if (slot->channel->fb != 0x00)
+        {
+            fbmod = (slot->prout + slot->out) >> (0x09 - slot->channel->fb);
+        }
+        if (slot->fbmod != fbmod)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void OPL3_GenerateIdle(struct opl3_chip *chip)
+{
+    Bit8u ii;
+    Bit8u n_bit;
+
+    for (ii = 0; ii < 36; ii++)
+    {
+        n_bit = ((chip->noise >> 14) ^ chip->noise) & 0x01;
+        chip->noise = (chip->noise >> 1) | (n_bit << 22);
+    }
+    OPL3_UpdateTimers(chip);
+}
+
 void OPL3_GenerateResampled(struct opl3_chip *chip, Bit32s *buf)
 {
     while (chip->samplecnt >= chip->rateratio)
@@ -1205,6 +1287,7 @@ void OPL3_Reset(struct opl3_chip *chip, Bit32u samplerate)
         chip->slot[slotnum].eg_out = 0x1ff;
         chip->slot[slotnum].eg_gen = envelope_gen_num_release;
         chip->slot[slotnum].trem = (Bit8u*)&chip->zeromod;
+        chip->slot[slotnum].wf = envelope_sin[0];
         chip->slot[slotnum].slot_num = slotnum;
     }
     for (channum = 0; channum < 18; channum++)
@@ -1252,6 +1335,7 @@ void OPL3_WriteReg(struct opl3_chip *chip, Bit16u reg, Bit8u v)
 {
     Bit8u high = (reg >> 8) & 0x01;
     Bit8u regm = reg & 0xff;
+    chip->quiet = 0;
     switch (regm & 0xf0)
     {
     case 0x00:
@@ -1375,13 +1459,93 @@ void OPL3_WriteRegBuffered(struct opl3_chip *chip, Bit16u reg, Bit8u v)
     chip->writebuf_last = (chip->writebuf_last + 1) % OPL_WRITEBUF_SIZE;
 }
 
-void OPL3_GenerateStream(struct opl3_chip *chip, Bit32s *sndptr, Bit32u numsamples)
+void OPL3_GenerateBlock(struct opl3_chip *chip, Bit16s *buf, Bit32u numsamples)
 {
     Bit32u i;
 
-    for(i = 0; i < numsamples; i++)
+    for (i = 0; i < numsamples; i++)
+    {
+        OPL3_Generate(chip, buf);
+        buf += 2;
+    }
+    if (numsamples)
+    {
+        chip->samples[0] = buf[-2];
+        chip->samples[1] = buf[-1];
+    }
+}
+
+void OPL3_GenerateStream(struct opl3_chip *chip, Bit32s *sndptr, Bit32u numsamples)
+{
+    Bit16s block[(OPL_BLOCK + 2) * 2];
+    Bit16s *cur;
+    Bit32s samplecnt;
+    Bit32u native, need;
+    Bit32u i, n;
+
+    if (OPL3_CheckIdle(chip))
     {
-        OPL3_GenerateResampled(chip, sndptr);
-        sndptr += 2;
+        for (i = 0; i < numsamples; i++)
+        {
+            while (chip->samplecnt >= chip->rateratio)
+            {
+                OPL3_GenerateIdle(chip);
+                chip->samplecnt -= chip->rateratio;
+            }
+            sndptr[0] = chip->samples[0];
+            sndptr[1] = chip->samples[1];
+            chip->samplecnt += 1 << RSM_FRAC;
+            sndptr += 2;
+        }
+        return;
+    }
+
+    while (numsamples)
+    {
+        // Count the output samples whose native samples fit in one block
+        samplecnt = chip->samplecnt;
+        native = 0;
+        for (n = 0; n < numsamples; n++)
+        {
+            need = 0;
+            while (samplecnt >= chip->rateratio)
+            {
+                samplecnt -= chip->rateratio;
+                need++;
+            }
+            if (native + need > OPL_BLOCK)
+            {
+                break;
+            }
+            native += need;
+            samplecnt += 1 << RSM_FRAC;
+        }
+
+        // Render them in one go, after the two samples carried over
+        block[0] = chip->oldsamples[0];
+        block[1] = chip->oldsamples[1];
+        block[2] = chip->samples[0];
+        block[3] = chip->samples[1];
+        OPL3_GenerateBlock(chip, &block[4], native);
+
+        // Then interpolate the output from the block
+        cur = &block[2];
+        for (i = 0; i < n; i++)
+        {
+            while (chip->samplecnt >= chip->rateratio)
+            {
+                chip->samplecnt -= chip->rateratio;
+                cur += 2;
+            }
+            sndptr[0] = (Bit32s)((cur[-2] * (chip->rateratio - chip->samplecnt)
+                                + cur[0] * chip->samplecnt) / chip->rateratio);
+            sndptr[1] = (Bit32s)((cur[-1] * (chip->rateratio - chip->samplecnt)
+                                + cur[1] * chip->samplecnt) / chip->rateratio);
+            chip->samplecnt += 1 << RSM_FRAC;
+            sndptr += 2;
+        }
+        chip->oldsamples[0] = cur[-2];
+        chip->oldsamples[1] = cur[-1];
+        numsamples -= n;
     }
 }
@@ -29,6 +29,7 @@
 #ifndef NUKEDOPL_H
 #define NUKEDOPL_H
 #define OPL_WRITEBUF_SIZE   1024
+#define OPL_BLOCK           256
 #define OPL_WRITEBUF_DELAY  1
 
 //#include "dosbox.h"
@@ -74,6 +75,7 @@ struct opl3_slot {
     Bit8u reg_sl;
     Bit8u reg_rr;
     Bit8u reg_wf;
+    Bit16s (*wf)(Bit16u phase, Bit16u envelope);
     Bit8u key;
     Bit32u pg_reset;
     Bit32u pg_phase;
@@ -133,6 +135,8 @@ struct opl3_chip {
     Bit32s samplecnt;
     Bit16s oldsamples[2];
     Bit16s samples[2];
+    //Samples generated since the last register write, saturating
+    Bit8u quiet;
 
     Bit64u writebuf_samplecnt;
     Bit32u writebuf_cur;
@@ -143,6 +147,7 @@ struct opl3_chip {
 
 void OPL3_Generate(struct opl3_chip *chip, Bit16s *buf);
 void OPL3_GenerateResampled(struct opl3_chip *chip, Bit32s *buf);
+void OPL3_GenerateBlock(struct opl3_chip *chip, Bit16s *buf, Bit32u numsamples);
 void OPL3_Reset(struct opl3_chip *chip, Bit32u samplerate);
 Bit32u OPL3_WriteAddr(struct opl3_chip *chip, Bit32u port, Bit8u val);
 void OPL3_WriteReg(struct opl3_chip *chip, Bit16u reg, Bit8u v);
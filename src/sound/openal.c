@@ -38,9 +38,9 @@
 #define BUFLEN	SOUNDBUFLEN
 
 
-ALuint buffers[4];		/* front and back buffers */
-ALuint buffers_cd[4];		/* front and back buffers */
-ALuint buffers_midi[4];		/* front and back buffers */
+ALuint buffers[SOUND_QUEUE_MAX];	/* front and back buffers */
+ALuint buffers_cd[SOUND_QUEUE_MAX];	/* front and back buffers */
+ALuint buffers_midi[SOUND_QUEUE_MAX];	/* front and back buffers */
 static ALuint source[3];	/* audio source */
 
 
@@ -48,18 +48,24 @@ static int midi_freq = 44100;
 static int midi_buf_size = 4410;
 static int initialized = 0;
 static int sources = 2;
+static int queue_depth = 4;
 static ALCcontext *Context;
 static ALCdevice *Device;
 
-void
-al_set_midi(int freq, int buf_size)
+/* The main stream is handed to OpenAL in blocks of sound_block_mult buffers. */
+static void *block_buf = NULL;
+static int block_fill = 0;
+
+
+static void
+openal_set_midi(int freq, int buf_size)
 {
     midi_freq = freq;
     midi_buf_size = buf_size;
 }
 
 
-void closeal(void);
+static void closeal(void);
 ALvoid alutInit(ALint *argc,ALbyte **argv) 
 {
     /* Open device */
@@ -93,7 +99,7 @@ alutExit(ALvoid)
 }
 
 
-void
+static void
 closeal(void)
 {
     if (!initialized)
@@ -103,22 +109,27 @@ closeal(void)
     alDeleteSources(sources, source);
 
     if (sources == 3)
-	alDeleteBuffers(4, buffers_midi);
-    alDeleteBuffers(4, buffers_cd);
-    alDeleteBuffers(4, buffers);
+	alDeleteBuffers(queue_depth, buffers_midi);
+    alDeleteBuffers(queue_depth, buffers_cd);
+    alDeleteBuffers(queue_depth, buffers);
 
     alutExit();
 
+    if (block_buf != NULL) {
+	free(block_buf);
+	block_buf = NULL;
+    }
+
     initialized = 0;
 }
 
 
-void
+static void
 inital(void)
 {
     float *buf = NULL, *cd_buf = NULL, *midi_buf = NULL;
     int16_t *buf_int16 = NULL, *cd_buf_int16 = NULL, *midi_buf_int16 = NULL;
-    int c;
+    int c, block_len = BUFLEN * sound_block_mult;
 
     char *mdn;
     int init_midi = 0;
@@ -129,6 +140,11 @@ inital(void)
     alutInit(0, 0);
     atexit(closeal);
 
+    queue_depth = sound_queue_depth;
+    block_fill = 0;
+    if (sound_block_mult > 1)
+	block_buf = malloc((block_len << 1) * (sound_is_float ? sizeof(float) : sizeof(int16_t)));
+
     mdn = midi_device_get_internal_name(midi_device_current);
     if (strcmp(mdn, "none") && strcmp(mdn, SYSTEM_MIDI_INTERNAL_NAME))
 	init_midi = 1;	/* If the device is neither none, nor system MIDI, initialize the
@@ -136,21 +152,21 @@ inital(void)
     sources = 2 + !!init_midi;
 
     if (sound_is_float) {
-	buf = (float *) malloc((BUFLEN << 1) * sizeof(float));
+	buf = (float *) malloc((block_len << 1) * sizeof(float));
 	cd_buf = (float *) malloc((CD_BUFLEN << 1) * sizeof(float));
 	if (init_midi)
 		midi_buf = (float *) malloc(midi_buf_size * sizeof(float));
     } else {
-	buf_int16 = (int16_t *) malloc((BUFLEN << 1) * sizeof(int16_t));
+	buf_int16 = (int16_t *) malloc((block_len << 1) * sizeof(int16_t));
 	cd_buf_int16 = (int16_t *) malloc((CD_BUFLEN << 1) * sizeof(int16_t));
 	if (init_midi)
 		midi_buf_int16 = (int16_t *) malloc(midi_buf_size * sizeof(int16_t));
     }
 
-    alGenBuffers(4, buffers);
-    alGenBuffers(4, buffers_cd);
+    alGenBuffers(queue_depth, buffers);
+    alGenBuffers(queue_depth, buffers_cd);
     if (init_midi)
-	alGenBuffers(4, buffers_midi);
+	alGenBuffers(queue_depth, buffers_midi);
 
     if (init_midi)
 	alGenSources(3, source);
@@ -176,35 +192,35 @@ inital(void)
     }
 
     if (sound_is_float) {
-	memset(buf,0,BUFLEN*2*sizeof(float));
-	memset(cd_buf,0,BUFLEN*2*sizeof(float));
+	memset(buf,0,block_len*2*sizeof(float));
+	memset(cd_buf,0,CD_BUFLEN*2*sizeof(float));
 	if (init_midi)
 		memset(midi_buf,0,midi_buf_size*sizeof(float));
     } else {
-	memset(buf_int16,0,BUFLEN*2*sizeof(int16_t));
-	memset(cd_buf_int16,0,BUFLEN*2*sizeof(int16_t));
+	memset(buf_int16,0,block_len*2*sizeof(int16_t));
+	memset(cd_buf_int16,0,CD_BUFLEN*2*sizeof(int16_t));
 	if (init_midi)
 		memset(midi_buf_int16,0,midi_buf_size*sizeof(int16_t));
     }
 
-    for (c=0; c<4; c++) {
+    for (c=0; c<queue_depth; c++) {
 	if (sound_is_float) {
-		alBufferData(buffers[c], AL_FORMAT_STEREO_FLOAT32, buf, BUFLEN*2*sizeof(float), FREQ);
+		alBufferData(buffers[c], AL_FORMAT_STEREO_FLOAT32, buf, block_len*2*sizeof(float), FREQ);
 		alBufferData(buffers_cd[c], AL_FORMAT_STEREO_FLOAT32, cd_buf, CD_BUFLEN*2*sizeof(float), CD_FREQ);
 		if (init_midi)
 			alBufferData(buffers_midi[c], AL_FORMAT_STEREO_FLOAT32, midi_buf, midi_buf_size*sizeof(float), midi_freq);
 	} else {
-		alBufferData(buffers[c], AL_FORMAT_STEREO16, buf_int16, BUFLEN*2*sizeof(int16_t), FREQ);
+		alBufferData(buffers[c], AL_FORMAT_STEREO16, buf_int16, block_len*2*sizeof(int16_t), FREQ);
 		alBufferData(buffers_cd[c], AL_FORMAT_STEREO16, cd_buf_int16, CD_BUFLEN*2*sizeof(int16_t), CD_FREQ);
 		if (init_midi)
 			alBufferData(buffers_midi[c], AL_FORMAT_STEREO16, midi_buf_int16, midi_buf_size*sizeof(int16_t), midi_freq);
 	}
     }
 
-    alSourceQueueBuffers(source[0], 4, buffers);
-    alSourceQueueBuffers(source[1], 4, buffers_cd);
+    alSourceQueueBuffers(source[0], queue_depth, buffers);
+    alSourceQueueBuffers(source[1], queue_depth, buffers_cd);
     if (init_midi)
-	alSourceQueueBuffers(source[2], 4, buffers_midi);
+	alSourceQueueBuffers(source[2], queue_depth, buffers_midi);
     alSourcePlay(source[0]);
     alSourcePlay(source[1]);
     if (init_midi)
@@ -226,17 +242,14 @@ inital(void)
 }
 
 
-void
-givealbuffer_common(void *buf, uint8_t src, int size, int freq)
+static void
+al_submit_common(void *buf, uint8_t src, int size, int freq)
 {
     int processed;
     int state;
     ALuint buffer;
     double gain;
 
-    if (!initialized)
-	return;
-
     alGetSourcei(source[src], AL_SOURCE_STATE, &state);
 
     if (state == 0x1014) {
@@ -260,22 +273,49 @@ givealbuffer_common(void *buf, uint8_t src, int size, int freq)
 }
 
 
-void
-givealbuffer(void *buf)
+static void
+al_submit(int stream, void *buf, int size, int freq)
 {
-    givealbuffer_common(buf, 0, BUFLEN << 1, FREQ);
-}
+    int sample_size = sound_is_float ? sizeof(float) : sizeof(int16_t);
 
+    if (!initialized || (stream >= sources))
+	return;
 
-void
-givealbuffer_cd(void *buf)
-{
-    givealbuffer_common(buf, 1, CD_BUFLEN << 1, CD_FREQ);
+    if ((stream == SOUND_STREAM_MAIN) && (block_buf != NULL)) {
+	memcpy((uint8_t *) block_buf + (block_fill * sample_size), buf, size * sample_size);
+	block_fill += size;
+	if (block_fill < ((BUFLEN << 1) * sound_block_mult))
+		return;
+
+	buf = block_buf;
+	size = block_fill;
+	block_fill = 0;
+    }
+
+    al_submit_common(buf, stream, size, freq);
 }
 
 
-void
-givealbuffer_midi(void *buf, uint32_t size)
+static int
+al_queued(int stream)
 {
-    givealbuffer_common(buf, 2, size, midi_freq);
+    int queued, processed;
+
+    if (!initialized || (stream >= sources))
+	return -1;
+
+    alGetSourcei(source[stream], AL_BUFFERS_QUEUED, &queued);
+    alGetSourcei(source[stream], AL_BUFFERS_PROCESSED, &processed);
+
+    return queued - processed;
 }
+
+
+const sound_backend_t openal_backend = {
+    "openal",
+    inital,
+    closeal,
+    openal_set_midi,
+    al_submit,
+    al_queued
+};
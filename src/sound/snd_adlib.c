@@ -122,6 +122,7 @@ void adlib_close(void *p)
 {
         adlib_t *adlib = (adlib_t *)p;
 
+        opl_close(&adlib->opl);
         free(adlib);
 }
 
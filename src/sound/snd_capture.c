@@ -0,0 +1,505 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		Audio capture to WAV files.
+ *
+ *		Every buffer handed to the audio backend (and, optionally,
+ *		each sound handler's own output) is copied into a per-stream
+ *		ring and written out by a background thread, so capturing
+ *		never blocks the emulation. If the writer falls behind, whole
+ *		buffers are dropped and counted.
+ *
+ *		Also contains the comparison used to check a capture against
+ *		a reference one.
+ *
+ * Version:	@(#)snd_capture.c	1.0.0	2020/01/20
+ */
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include "../86box.h"
+#include "../plat.h"
+#include "sound.h"
+#include "snd_capture.h"
+
+
+#define CAPTURE_RING		32
+#define CAPTURE_RING_MASK	(CAPTURE_RING - 1)
+
+#define WAV_HEADER_SIZE		44
+#define WAV_FORMAT_PCM		1
+#define WAV_FORMAT_FLOAT	3
+
+
+typedef struct {
+    void	*data;
+    int		size, alloc;		/* in bytes */
+} capture_block_t;
+
+typedef struct {
+    FILE	*f;
+    int		freq, is_float;
+    uint32_t	data_bytes;
+    uint32_t	dropped;
+
+    capture_block_t ring[CAPTURE_RING];
+    volatile int wp, rp;
+} capture_stream_t;
+
+
+wchar_t		sound_capture_path[1024];
+int		sound_capture_sources = 0;
+int		sound_capture_active = 0;
+
+
+static capture_stream_t	capture_streams[CAPTURE_STREAMS];
+static thread_t		*capture_thread_h;
+static event_t		*capture_event;
+static volatile int	capture_quit;
+static volatile int	capture_sync;
+
+
+#ifdef ENABLE_SOUND_CAPTURE_LOG
+int sound_capture_do_log = ENABLE_SOUND_CAPTURE_LOG;
+
+
+static void
+capture_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (sound_capture_do_log) {
+	va_start(ap, fmt);
+	pclog_ex(fmt, ap);
+	va_end(ap);
+    }
+}
+#else
+#define capture_log(fmt, ...)
+#endif
+
+
+static void
+capture_put16(uint8_t *p, uint16_t val)
+{
+    p[0] = val & 0xff;
+    p[1] = val >> 8;
+}
+
+
+static void
+capture_put32(uint8_t *p, uint32_t val)
+{
+    capture_put16(p, val & 0xffff);
+    capture_put16(p + 2, val >> 16);
+}
+
+
+static uint16_t
+capture_get16(uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+
+static uint32_t
+capture_get32(uint8_t *p)
+{
+    return capture_get16(p) | ((uint32_t) capture_get16(p + 2) << 16);
+}
+
+
+/* Stereo, 16-bit PCM or 32-bit float. */
+static void
+capture_write_header(capture_stream_t *s)
+{
+    uint8_t hdr[WAV_HEADER_SIZE];
+    int bits = s->is_float ? 32 : 16;
+
+    memcpy(hdr, "RIFF", 4);
+    capture_put32(hdr + 4, WAV_HEADER_SIZE - 8 + s->data_bytes);
+    memcpy(hdr + 8, "WAVEfmt ", 8);
+    capture_put32(hdr + 16, 16);
+    capture_put16(hdr + 20, s->is_float ? WAV_FORMAT_FLOAT : WAV_FORMAT_PCM);
+    capture_put16(hdr + 22, 2);
+    capture_put32(hdr + 24, s->freq);
+    capture_put32(hdr + 28, s->freq * 2 * (bits >> 3));
+    capture_put16(hdr + 32, 2 * (bits >> 3));
+    capture_put16(hdr + 34, bits);
+    memcpy(hdr + 36, "data", 4);
+    capture_put32(hdr + 40, s->data_bytes);
+
+    fseek(s->f, 0, SEEK_SET);
+    fwrite(hdr, 1, WAV_HEADER_SIZE, s->f);
+}
+
+
+/* foo.wav -> foo.wav, foo_cd.wav, foo_midi.wav, foo_src0.wav, ... */
+static FILE *
+capture_open(int stream)
+{
+    wchar_t fn[1024 + 16];
+    wchar_t *ext;
+
+    wcscpy(fn, sound_capture_path);
+    ext = wcsrchr(fn, L'.');
+    if ((ext != NULL) && !wcscasecmp(ext, L".wav"))
+	*ext = L'\0';
+
+    switch (stream) {
+	case CAPTURE_MAIN:
+		break;
+	case CAPTURE_CD:
+		wcscat(fn, L"_cd");
+		break;
+	case CAPTURE_MIDI:
+		wcscat(fn, L"_midi");
+		break;
+	default:
+		swprintf(fn + wcslen(fn), 16, L"_src%i", stream - CAPTURE_SOURCE);
+		break;
+    }
+    wcscat(fn, L".wav");
+
+    return plat_fopen(fn, L"wb");
+}
+
+
+static void
+capture_drain(int stream)
+{
+    capture_stream_t *s = &capture_streams[stream];
+    capture_block_t *b;
+
+    while (s->rp != s->wp) {
+	b = &s->ring[s->rp];
+
+	if (s->f == NULL) {
+		s->f = capture_open(stream);
+		if (s->f == NULL) {
+			pclog("Sound capture: unable to create file for stream %i\n", stream);
+			s->rp = s->wp;
+			return;
+		}
+		capture_write_header(s);
+	}
+
+	fwrite(b->data, 1, b->size, s->f);
+	s->data_bytes += b->size;
+
+	s->rp = (s->rp + 1) & CAPTURE_RING_MASK;
+    }
+}
+
+
+static void
+capture_thread(void *param)
+{
+    int c;
+
+    while (!capture_quit) {
+	thread_wait_event(capture_event, -1);
+	thread_reset_event(capture_event);
+
+	for (c = 0; c < CAPTURE_STREAMS; c++)
+		capture_drain(c);
+
+	if (capture_sync) {
+		capture_sync = 0;
+
+		/* Make the files valid as they stand, and carry on. */
+		for (c = 0; c < CAPTURE_STREAMS; c++) {
+			if (capture_streams[c].f != NULL) {
+				capture_write_header(&capture_streams[c]);
+				fseek(capture_streams[c].f, 0, SEEK_END);
+				fflush(capture_streams[c].f);
+			}
+		}
+	}
+    }
+}
+
+
+void
+sound_capture_start(void)
+{
+    if (sound_capture_active || (sound_capture_path[0] == L'\0'))
+	return;
+
+    memset(capture_streams, 0, sizeof(capture_streams));
+
+    capture_quit = 0;
+    capture_sync = 0;
+    capture_event = thread_create_event();
+    capture_thread_h = thread_create(capture_thread, NULL);
+
+    sound_capture_active = 1;
+
+    pclog("Sound capture: writing to %ls\n", sound_capture_path);
+}
+
+
+void
+sound_capture_stop(void)
+{
+    capture_stream_t *s;
+    int c, d;
+
+    if (!sound_capture_active)
+	return;
+
+    sound_capture_active = 0;
+
+    capture_quit = 1;
+    thread_set_event(capture_event);
+    thread_wait(capture_thread_h, -1);
+    thread_destroy_event(capture_event);
+    capture_thread_h = NULL;
+    capture_event = NULL;
+
+    for (c = 0; c < CAPTURE_STREAMS; c++) {
+	s = &capture_streams[c];
+
+	capture_drain(c);
+
+	if (s->f != NULL) {
+		capture_write_header(s);
+		fclose(s->f);
+		s->f = NULL;
+
+		capture_log("Sound capture: stream %i, %u bytes, %u buffers dropped\n",
+			    c, s->data_bytes, s->dropped);
+		if (s->dropped)
+			pclog("Sound capture: stream %i dropped %u buffers\n", c, s->dropped);
+	}
+
+	for (d = 0; d < CAPTURE_RING; d++) {
+		if (s->ring[d].data != NULL)
+			free(s->ring[d].data);
+	}
+    }
+
+    memset(capture_streams, 0, sizeof(capture_streams));
+}
+
+
+/* Have the headers brought up to date, without ending the capture. */
+void
+sound_capture_sync(void)
+{
+    if (!sound_capture_active)
+	return;
+
+    capture_sync = 1;
+    thread_set_event(capture_event);
+}
+
+
+/* Size is in samples (not frames), in the current output format. */
+void
+sound_capture_write(int stream, void *buf, int size, int freq)
+{
+    capture_stream_t *s = &capture_streams[stream];
+    capture_block_t *b;
+    int bytes;
+
+    if (!sound_capture_active)
+	return;
+
+    if (((s->wp + 1) & CAPTURE_RING_MASK) == s->rp) {
+	s->dropped++;
+	return;
+    }
+
+    /* The format of a file is fixed by its first buffer. */
+    if (s->freq == 0) {
+	s->freq = freq;
+	s->is_float = sound_is_float;
+    } else if ((s->freq != freq) || (s->is_float != sound_is_float))
+	return;
+
+    bytes = size * (sound_is_float ? sizeof(float) : sizeof(int16_t));
+
+    b = &s->ring[s->wp];
+    if (b->alloc < bytes) {
+	b->data = realloc(b->data, bytes);
+	b->alloc = bytes;
+    }
+    memcpy(b->data, buf, bytes);
+    b->size = bytes;
+
+    s->wp = (s->wp + 1) & CAPTURE_RING_MASK;
+
+    thread_set_event(capture_event);
+}
+
+
+typedef struct {
+    FILE	*f;
+    int		format, channels, freq, bits;
+    uint32_t	data_bytes;
+} wav_info_t;
+
+
+static int
+capture_wav_open(wchar_t *fn, wav_info_t *wav)
+{
+    uint8_t chunk[16];
+    uint32_t size;
+
+    memset(wav, 0, sizeof(wav_info_t));
+
+    wav->f = plat_fopen(fn, L"rb");
+    if (wav->f == NULL) {
+	printf("%ls: unable to open\n", fn);
+	return 0;
+    }
+
+    if ((fread(chunk, 1, 12, wav->f) != 12) ||
+	memcmp(chunk, "RIFF", 4) || memcmp(chunk + 8, "WAVE", 4)) {
+	printf("%ls: not a WAV file\n", fn);
+	fclose(wav->f);
+	return 0;
+    }
+
+    while (fread(chunk, 1, 8, wav->f) == 8) {
+	size = capture_get32(chunk + 4);
+
+	if (!memcmp(chunk, "fmt ", 4) && (size >= 16)) {
+		if (fread(chunk, 1, 16, wav->f) != 16)
+			break;
+		wav->format = capture_get16(chunk);
+		wav->channels = capture_get16(chunk + 2);
+		wav->freq = capture_get32(chunk + 4);
+		wav->bits = capture_get16(chunk + 14);
+		size -= 16;
+	} else if (!memcmp(chunk, "data", 4)) {
+		wav->data_bytes = size;
+		if (wav->bits && wav->channels)
+			return 1;
+		break;
+	}
+
+	fseek(wav->f, size + (size & 1), SEEK_CUR);
+    }
+
+    printf("%ls: no usable fmt/data chunks\n", fn);
+    fclose(wav->f);
+    return 0;
+}
+
+
+static double
+capture_sample(uint8_t *p, wav_info_t *wav)
+{
+    float f;
+
+    if (wav->format == WAV_FORMAT_FLOAT) {
+	memcpy(&f, p, sizeof(float));
+	return f;
+    }
+
+    return (int16_t) capture_get16(p);
+}
+
+
+/*
+ * Compare a capture against a reference, sample by sample, and report the
+ * first divergence. Returns 0 if the two are identical.
+ */
+int
+sound_capture_compare(wchar_t *ref, wchar_t *test)
+{
+    wav_info_t wav[2];
+    uint8_t buf[2][4096];
+    uint32_t pos = 0, len, frame_bytes, sample_bytes, differ = 0;
+    uint32_t first = 0xffffffff, c;
+    double a, b, diff, max_diff = 0.0;
+    int ret;
+
+    if (!capture_wav_open(ref, &wav[0]))
+	return 2;
+    if (!capture_wav_open(test, &wav[1])) {
+	fclose(wav[0].f);
+	return 2;
+    }
+
+    if ((wav[0].format != wav[1].format) || (wav[0].channels != wav[1].channels) ||
+	(wav[0].freq != wav[1].freq) || (wav[0].bits != wav[1].bits) ||
+	((wav[0].format != WAV_FORMAT_FLOAT) && (wav[0].bits != 16)) ||
+	((wav[0].format == WAV_FORMAT_FLOAT) && (wav[0].bits != 32))) {
+	printf("Formats differ or are unsupported: %i/%ich/%iHz/%ibit vs. %i/%ich/%iHz/%ibit\n",
+	       wav[0].format, wav[0].channels, wav[0].freq, wav[0].bits,
+	       wav[1].format, wav[1].channels, wav[1].freq, wav[1].bits);
+	fclose(wav[0].f);
+	fclose(wav[1].f);
+	return 2;
+    }
+
+    sample_bytes = wav[0].bits >> 3;
+    frame_bytes = sample_bytes * wav[0].channels;
+    len = (wav[0].data_bytes < wav[1].data_bytes) ? wav[0].data_bytes : wav[1].data_bytes;
+    len -= len % frame_bytes;
+
+    while (pos < len) {
+	uint32_t chunk = len - pos;
+
+	if (chunk > (sizeof(buf[0]) - (sizeof(buf[0]) % frame_bytes)))
+		chunk = sizeof(buf[0]) - (sizeof(buf[0]) % frame_bytes);
+
+	if ((fread(buf[0], 1, chunk, wav[0].f) != chunk) ||
+	    (fread(buf[1], 1, chunk, wav[1].f) != chunk))
+		break;
+
+	if (memcmp(buf[0], buf[1], chunk)) {
+		for (c = 0; c < chunk; c += sample_bytes) {
+			a = capture_sample(&buf[0][c], &wav[0]);
+			b = capture_sample(&buf[1][c], &wav[1]);
+			if (a == b)
+				continue;
+
+			if (first == 0xffffffff) {
+				first = pos + c;
+				printf("First divergence at frame %u (%.6f s), channel %u: %g vs. %g\n",
+				       first / frame_bytes, (double) (first / frame_bytes) / wav[0].freq,
+				       (first % frame_bytes) / sample_bytes, a, b);
+			}
+
+			differ++;
+			diff = (a > b) ? (a - b) : (b - a);
+			if (diff > max_diff)
+				max_diff = diff;
+		}
+	}
+
+	pos += chunk;
+    }
+
+    ret = (differ != 0);
+    if (differ)
+	printf("%u of %u samples differ, largest difference %g\n",
+	       differ, pos / sample_bytes, max_diff);
+
+    if (wav[0].data_bytes != wav[1].data_bytes) {
+	printf("Lengths differ: %u vs. %u frames\n",
+	       wav[0].data_bytes / frame_bytes, wav[1].data_bytes / frame_bytes);
+	ret = 1;
+    }
+
+    if (!ret)
+	printf("Identical, %u frames\n", pos / frame_bytes);
+
+    fclose(wav[0].f);
+    fclose(wav[1].f);
+
+    return ret;
+}
@@ -0,0 +1,38 @@
+/*
+ * 86Box	A hypervisor and IBM PC system emulator that specializes in
+ *		running old operating systems and software designed for IBM
+ *		PC systems and compatibles from 1981 through fairly recent
+ *		system designs based on the PCI bus.
+ *
+ *		This file is part of the 86Box distribution.
+ *
+ *		Definitions for the audio capture to WAV files.
+ *
+ * Version:	@(#)snd_capture.h	1.0.0	2020/01/20
+ */
+#ifndef SOUND_CAPTURE_H
+# define SOUND_CAPTURE_H
+
+
+/* Capture streams. The first three match the OpenAL sources. */
+#define CAPTURE_MAIN		0
+#define CAPTURE_CD		1
+#define CAPTURE_MIDI		2
+#define CAPTURE_SOURCE		3	/* + sound handler index */
+#define CAPTURE_STREAMS		(CAPTURE_SOURCE + 8)
+
+
+extern wchar_t	sound_capture_path[1024];	/* (O) base name of capture */
+extern int	sound_capture_sources;		/* (O) also capture each handler */
+extern int	sound_capture_active;
+
+
+extern void	sound_capture_start(void);
+extern void	sound_capture_stop(void);
+extern void	sound_capture_sync(void);
+extern void	sound_capture_write(int stream, void *buf, int size, int freq);
+
+extern int	sound_capture_compare(wchar_t *ref, wchar_t *test);
+
+
+#endif	/*SOUND_CAPTURE_H*/
@@ -38,6 +38,29 @@ typedef struct cms_t
 
 void cms_update(cms_t *cms)
 {
+        if (!(cms->regs[0][0x1C] & 1) && !(cms->regs[1][0x1C] & 1))
+        {
+                /*Both chips disabled - nothing but the noise frequencies is touched,
+                  and those only depend on registers, so fill silence directly*/
+                int c;
+
+                if (cms->pos >= sound_pos_global)
+                        return;
+                for (c = 0; c < 4; c++)
+                {
+                        switch (cms->noisetype[c >> 1][c & 1])
+                        {
+                                case 0: cms->noisefreq[c >> 1][c & 1] = MASTER_CLOCK/256; break;
+                                case 1: cms->noisefreq[c >> 1][c & 1] = MASTER_CLOCK/512; break;
+                                case 2: cms->noisefreq[c >> 1][c & 1] = MASTER_CLOCK/1024; break;
+                                case 3: cms->noisefreq[c >> 1][c & 1] = cms->freq[c >> 1][(c & 1) * 3]; break;
+                        }
+                }
+                memset(&cms->buffer[cms->pos << 1], 0, (sound_pos_global - cms->pos) * 2 * sizeof(int16_t));
+                cms->pos = sound_pos_global;
+                return;
+        }
+
         for (; cms->pos < sound_pos_global; cms->pos++)
         {
                 int c, d;
@@ -1720,6 +1720,19 @@ int32_t emu8k_vol_slide(emu8k_slide_t* slide, int32_t target)
         return slide->last;
 }
 
+/* A voice with no pitch, no volume, the filter bypassed and the envelope
+ * engine off neither moves nor contributes to the output, so running it
+ * would not change any state. This is the state drivers leave unused
+ * voices in. */
+static inline int emu8k_voice_idle(emu8k_voice_t *emu_voice)
+{
+        return !emu_voice->env_engine_on &&
+                !emu_voice->cpf_curr_pitch && !emu_voice->ptrx_pit_target &&
+                !emu_voice->cvcf_curr_volume && !emu_voice->vtft_vol_target && !emu_voice->volumeslide.last &&
+                !emu_voice->filterq_idx && emu_voice->cvcf_curr_filt_ctoff == 0xFFFF && emu_voice->vtft_filter_target == 0xFFFF &&
+                emu_voice->addr.addr < emu_voice->loop_end.addr;
+}
+
 //int32_t old_pitch[32]={0};
 //int32_t old_cut[32]={0};
 //int32_t old_vol[32]={0};
@@ -1731,7 +1744,9 @@ void emu8k_update(emu8k_t *emu8k)
 
         int32_t *buf;
         emu8k_voice_t* emu_voice;
-        int pos;
+        /* Output of the voice being rendered, after volume, mixed in one pass per voice. */
+        int32_t voice_out[SOUNDBUFLEN];
+        int pos, start;
         int c;
 
         /* Clean the buffers since we will accumulate into them. */
@@ -1743,10 +1758,16 @@ void emu8k_update(emu8k_t *emu8k)
         /* Voices section  */
         for (c = 0; c < 32; c++)
         {
+                int out_enabled;
+
                 emu_voice = &emu8k->voice[c];
-                buf = &emu8k->buffer[emu8k->pos*2];
                 
-                for (pos = emu8k->pos; pos < new_pos; pos++)
+                /* ccca is only written back after the loop, so DMA state is fixed for the whole block. */
+                out_enabled = (emu8k->hwcf3 & 0x04) && !CCCA_DMA_ACTIVE(emu_voice->ccca);
+
+                /* Silent voices are skipped entirely. */
+                start = emu8k_voice_idle(emu_voice) ? new_pos : emu8k->pos;
+                for (pos = start; pos < new_pos; pos++)
                 {
                         int32_t dat;
 
@@ -1834,23 +1855,10 @@ void emu8k_update(emu8k_t *emu8k)
                 #endif
                                 
                         }
-                        if (( emu8k->hwcf3 & 0x04) && !CCCA_DMA_ACTIVE(emu_voice->ccca))
+                        if (out_enabled)
                         {
-                                /*volume and pan*/
-                                dat = (dat * emu_voice->cvcf_curr_volume) >> 16;
-
-                                (*buf++) += (dat * emu_voice->vol_l) >> 8;
-                                (*buf++) += (dat * emu_voice->vol_r) >> 8;
-
-                                /* Effects section */
-                                if (emu_voice->ptrx_revb_send > 0)
-                                {
-                                        emu8k->reverb_in_buffer[pos]+=(dat*emu_voice->ptrx_revb_send) >> 8;
-                                }
-                                if (emu_voice->csl_chor_send > 0) 
-                                {
-                                        emu8k->chorus_in_buffer[pos]+=(dat*emu_voice->csl_chor_send) >> 8;
-                                }
+                                /*volume*/
+                                voice_out[pos - start] = (dat * emu_voice->cvcf_curr_volume) >> 16;
                         }
 
                         if ( emu_voice->env_engine_on)
@@ -2092,6 +2100,33 @@ I've recopilated these sentences to get an idea of how to loop
                         emu_voice->cvcf_curr_filt_ctoff = emu_voice->vtft_filter_target;
                 }
                 
+                if (out_enabled && start < new_pos)
+                {
+                        int count = new_pos - start;
+                        int i;
+
+                        /* Pan and effect sends don't change within the block, so they are
+                         * applied as straight loops that the compiler can vectorize. */
+                        buf = &emu8k->buffer[start*2];
+                        for (i = 0; i < count; i++)
+                        {
+                                buf[i*2]     += (voice_out[i] * emu_voice->vol_l) >> 8;
+                                buf[i*2 + 1] += (voice_out[i] * emu_voice->vol_r) >> 8;
+                        }
+                        if (emu_voice->ptrx_revb_send > 0)
+                        {
+                                int32_t *rev = &emu8k->reverb_in_buffer[start];
+                                for (i = 0; i < count; i++)
+                                        rev[i] += (voice_out[i] * emu_voice->ptrx_revb_send) >> 8;
+                        }
+                        if (emu_voice->csl_chor_send > 0)
+                        {
+                                int32_t *chor = &emu8k->chorus_in_buffer[start];
+                                for (i = 0; i < count; i++)
+                                        chor[i] += (voice_out[i] * emu_voice->csl_chor_send) >> 8;
+                        }
+                }
+
                 /* Update EMU voice registers. */
                 emu_voice->ccca = (((uint32_t)emu_voice->ccca_qcontrol) << 24) | emu_voice->addr.int_address;
                 emu_voice->cpf_curr_frac_addr = emu_voice->addr.fract_address;
@@ -49,6 +49,7 @@ typedef struct gus_t
         
         pc_timer_t samp_timer; 
 	uint64_t samp_latch;
+        uint64_t samp_ts; /*Timestamp of the next GF1 sample to be rendered*/
         
         uint8_t *ram;
         
@@ -82,6 +83,9 @@ static int gus_irqs[8] = {-1, 2, 5, 3, 7, 11, 12, 15};
 static int gus_irqs_midi[8] = {-1, 2, 5, 3, 7, 11, 12, 15};
 static int gus_dmas[8] = {-1, 1, 3, 5, 6, 7, -1, -1};
 
+/*Maximum number of GF1 samples between wakeups when no voice IRQ is due*/
+#define GUS_RENDER_MAX 1024
+
 int gusfreqs[]=
 {
         44100,41160,38587,36317,34300,32494,30870,29400,28063,26843,25725,24696,
@@ -803,9 +807,9 @@ void gus_poll_timer_2(void *p)
         }
 }
 
-static void gus_update(gus_t *gus)
+static void gus_update(gus_t *gus, int end)
 {
-        for (; gus->pos < sound_pos_global; gus->pos++)
+        for (; gus->pos < end; gus->pos++)
         {
                 if (gus->out_l < -32768)
                         gus->buffer[0][gus->pos] = -32768;
@@ -822,19 +826,15 @@ static void gus_update(gus_t *gus)
         }
 }
 
-void gus_poll_wave(void *p)
+/*Run one GF1 output sample*/
+static void gus_tick(gus_t *gus)
 {
-        gus_t *gus = (gus_t *)p;
         uint32_t addr;
         int d;
         int16_t v;
         int32_t vl;
         int update_irqs = 0;
         
-        gus_update(gus);
-        
-	timer_advance_u64(&gus->samp_timer, gus->samp_latch);
-        
         gus->out_l = gus->out_r = 0;
 
         if ((gus->reset & 3) != 3)
@@ -983,12 +983,111 @@ void gus_poll_wave(void *p)
                 pollgusirqs(gus);
 }
 
+/*Run every GF1 sample that is due by now. Each one first fills the output
+  buffer up to the point in the sound stream where it would have been run by
+  its own timer.*/
+static void gus_render(gus_t *gus)
+{
+        while (TIMER_VAL_LESS_THAN_VAL((uint32_t)(gus->samp_ts >> 32), (uint32_t)tsc))
+        {
+                gus_update(gus, sound_pos_at(gus->samp_ts));
+                gus_tick(gus);
+                gus->samp_ts += gus->samp_latch;
+        }
+}
+
+/*Arm the wakeup timer for the first sample that could raise a wave or volume
+  ramp IRQ. The counts are lower bounds, so waking early just renders and
+  rearms; everything else is caught up on the next register access.*/
+static void gus_schedule(gus_t *gus)
+{
+        uint32_t samples = GUS_RENDER_MAX;
+        uint32_t n;
+        int d;
+
+        for (d = 0; d < 32; d++)
+        {
+                if (!(gus->ctrl[d] & 3) && (gus->ctrl[d] & 0x20) && !gus->waveirqs[d])
+                {
+                        uint32_t step = gus->freq[d] >> 1;
+
+                        if (gus->ctrl[d] & 0x40)
+                        {
+                                if (gus->cur[d] <= gus->start[d])
+                                        samples = 0;
+                                else if (step && ((n = (gus->cur[d] - gus->start[d]) / step) < samples))
+                                        samples = n;
+                        }
+                        else
+                        {
+                                if (gus->cur[d] >= gus->end[d])
+                                        samples = 0;
+                                else if (step && ((n = (gus->end[d] - gus->cur[d]) / step) < samples))
+                                        samples = n;
+                        }
+                }
+                if (!(gus->rctrl[d] & 3) && (gus->rctrl[d] & 0x20) && !gus->rampirqs[d])
+                {
+                        if (gus->rctrl[d] & 0x40)
+                        {
+                                if (gus->rcur[d] <= gus->rstart[d])
+                                        samples = 0;
+                                else if (gus->rfreq[d] && ((n = (uint32_t)(gus->rcur[d] - gus->rstart[d]) / gus->rfreq[d]) < samples))
+                                        samples = n;
+                        }
+                        else
+                        {
+                                if (gus->rcur[d] >= gus->rend[d])
+                                        samples = 0;
+                                else if (gus->rfreq[d] && ((n = (uint32_t)(gus->rend[d] - gus->rcur[d]) / gus->rfreq[d]) < samples))
+                                        samples = n;
+                        }
+                }
+        }
+
+        if (samples)
+                samples--;
+        gus->samp_timer.ts.ts64 = gus->samp_ts + (samples * gus->samp_latch);
+        timer_enable(&gus->samp_timer);
+}
+
+void gus_poll_wave(void *p)
+{
+        gus_t *gus = (gus_t *)p;
+
+        gus_render(gus);
+        gus_schedule(gus);
+}
+
+static void gus_write(uint16_t addr, uint8_t val, void *p)
+{
+        gus_t *gus = (gus_t *)p;
+
+        gus_render(gus);
+        writegus(addr, val, p);
+        gus_schedule(gus);
+}
+
+static uint8_t gus_read(uint16_t addr, void *p)
+{
+        gus_t *gus = (gus_t *)p;
+        uint8_t val;
+
+        gus_render(gus);
+        val = readgus(addr, p);
+        gus_schedule(gus);
+
+        return val;
+}
+
 static void gus_get_buffer(int32_t *buffer, int len, void *p)
 {
         gus_t *gus = (gus_t *)p;
         int c;
 
-        gus_update(gus);
+        gus_render(gus);
+        gus_update(gus, sound_pos_global);
+        gus_schedule(gus);
         
         for (c = 0; c < len * 2; c++)
         {
@@ -1027,11 +1126,12 @@ void *gus_init(const device_t *info)
 
         gus->t1l = gus->t2l = 0xff;
                 
-        io_sethandler(0x0240, 0x0010, readgus, NULL, NULL, writegus, NULL, NULL,  gus);
-        io_sethandler(0x0340, 0x0010, readgus, NULL, NULL, writegus, NULL, NULL,  gus);
-        io_sethandler(0x0746, 0x0001, readgus, NULL, NULL, writegus, NULL, NULL,  gus);        
-        io_sethandler(0x0388, 0x0002, readgus, NULL, NULL, writegus, NULL, NULL,  gus);
+        io_sethandler(0x0240, 0x0010, gus_read, NULL, NULL, gus_write, NULL, NULL,  gus);
+        io_sethandler(0x0340, 0x0010, gus_read, NULL, NULL, gus_write, NULL, NULL,  gus);
+        io_sethandler(0x0746, 0x0001, gus_read, NULL, NULL, gus_write, NULL, NULL,  gus);        
+        io_sethandler(0x0388, 0x0002, gus_read, NULL, NULL, gus_write, NULL, NULL,  gus);
 		timer_add(&gus->samp_timer, gus_poll_wave, gus, 1);
+		gus->samp_ts = gus->samp_timer.ts.ts64;
 		timer_add(&gus->timer_1, gus_poll_timer_1, gus, 1);
 		timer_add(&gus->timer_2, gus_poll_timer_2, gus, 1);
 
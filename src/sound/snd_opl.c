@@ -107,17 +107,62 @@ opl3_write(uint16_t a, uint8_t v, void *priv)
 }
 
 
+static void
+opl2_render(void *priv, int32_t *buffer, int start, int end)
+{
+    opl_t *opl = (opl_t *)priv;
+    int c;
+
+    opl2_update(0, &buffer[start << 1], end - start);
+    opl2_update(1, &opl->buffer2[start << 1], end - start);
+    for (c = start; c < end; c++) {
+	buffer[(c << 1) + 1] = opl->buffer2[(c << 1) + 1];
+	opl->filtbuf[0] = buffer[c << 1]       = (buffer[c << 1] / 2);
+	opl->filtbuf[1] = buffer[(c << 1) + 1] = (buffer[(c << 1) + 1] / 2);
+    }
+}
+
+
+static void
+opl3_render(void *priv, int32_t *buffer, int start, int end)
+{
+    opl_t *opl = (opl_t *)priv;
+    int c;
+
+    opl3_update(0, &buffer[start << 1], end - start);
+    for (c = start; c < end; c++) {
+	opl->filtbuf[0] = buffer[c << 1]       = (buffer[c << 1]       / 2);
+	opl->filtbuf[1] = buffer[(c << 1) + 1] = (buffer[(c << 1) + 1] / 2);
+    }
+}
+
+
+/*With a synthesis worker, register writes are queued and the chip is only
+  rendered at the end of each buffer, one buffer behind.*/
+static int
+opl_worker_update(opl_t *opl)
+{
+    if (opl->worker == NULL)
+	return 0;
+
+    if (sound_pos_global == SOUNDBUFLEN) {
+	sound_worker_get_buffer(opl->worker, opl->buffer);
+	opl->pos = sound_pos_global;
+    }
+
+    return 1;
+}
+
+
 void
 opl2_update2(opl_t *opl)
 {
+    if (opl_worker_update(opl))
+	return;
+
     if (opl->pos < sound_pos_global) {
-	opl2_update(0, &opl->buffer[opl->pos << 1], sound_pos_global - opl->pos);
-	opl2_update(1, &opl->buffer2[opl->pos << 1], sound_pos_global - opl->pos);
-	for (; opl->pos < sound_pos_global; opl->pos++) {
-		opl->buffer[(opl->pos << 1) + 1] = opl->buffer2[(opl->pos << 1) + 1];
-		opl->filtbuf[0] = opl->buffer[opl->pos << 1]   = (opl->buffer[opl->pos << 1] / 2);
-		opl->filtbuf[1] = opl->buffer[(opl->pos << 1) + 1] = (opl->buffer[(opl->pos << 1) + 1] / 2);
-	}
+	opl2_render(opl, opl->buffer, opl->pos, sound_pos_global);
+	opl->pos = sound_pos_global;
     }
 }
 
@@ -125,12 +170,12 @@ opl2_update2(opl_t *opl)
 void
 opl3_update2(opl_t *opl)
 {
+    if (opl_worker_update(opl))
+	return;
+
     if (opl->pos < sound_pos_global) {
-	opl3_update(0, &opl->buffer[(opl->pos << 1)], sound_pos_global - opl->pos);
-	for (; opl->pos < sound_pos_global; opl->pos++) {
-		opl->filtbuf[0] = opl->buffer[opl->pos << 1]   = (opl->buffer[opl->pos << 1]   / 2);
-		opl->filtbuf[1] = opl->buffer[(opl->pos << 1) + 1] = (opl->buffer[(opl->pos << 1) + 1] / 2);
-	}
+	opl3_render(opl, opl->buffer, opl->pos, sound_pos_global);
+	opl->pos = sound_pos_global;
     }
 }
 
@@ -171,6 +216,22 @@ ymf262_timer_set(void *param, int timer, uint64_t period)
 }
 
 
+static void
+opl_worker_queue(void *param, int nr, uint16_t reg, uint8_t val)
+{
+    opl_t *opl = (opl_t *)param;
+
+    sound_worker_write(opl->worker, (nr << 9) | reg, val);
+}
+
+
+static void
+opl_worker_write(void *priv, uint16_t addr, uint8_t val)
+{
+    opl_write_reg(addr >> 9, addr & 0x1ff, val);
+}
+
+
 static void
 opl_timer_callback00(void *p)
 {
@@ -209,6 +270,12 @@ opl2_init(opl_t *opl)
     timer_add(&opl->timers[0][1], opl_timer_callback01, (void *)opl, 0);
     timer_add(&opl->timers[1][0], opl_timer_callback10, (void *)opl, 0);
     timer_add(&opl->timers[1][1], opl_timer_callback11, (void *)opl, 0);
+
+    if (sound_worker_enable) {
+	opl->worker = sound_worker_create(opl2_render, opl_worker_write, opl);
+	opl_set_write_callback(0, opl_worker_queue);
+	opl_set_write_callback(1, opl_worker_queue);
+    }
 }
 
 
@@ -219,4 +286,21 @@ opl3_init(opl_t *opl)
 
     timer_add(&opl->timers[0][0], opl_timer_callback00, (void *)opl, 0);
     timer_add(&opl->timers[0][1], opl_timer_callback01, (void *)opl, 0);
+
+    if (sound_worker_enable) {
+	opl->worker = sound_worker_create(opl3_render, opl_worker_write, opl);
+	opl_set_write_callback(0, opl_worker_queue);
+    }
+}
+
+
+void
+opl_close(opl_t *opl)
+{
+    if (opl->worker) {
+	sound_worker_close(opl->worker);
+	opl->worker = NULL;
+	opl_set_write_callback(0, NULL);
+	opl_set_write_callback(1, NULL);
+    }
 }
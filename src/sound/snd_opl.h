@@ -10,6 +10,8 @@ typedef struct opl_t
 		buffer2[SOUNDBUFLEN * 2];
 
     pc_timer_t	timers[2][2];
+
+    sound_worker_t	*worker;
 } opl_t;
 
 
@@ -27,6 +29,7 @@ extern void	opl3_poll(opl_t *opl, int16_t *bufl, int16_t *bufr);
 
 extern void	opl2_init(opl_t *opl);
 extern void	opl3_init(opl_t *opl);
+extern void	opl_close(opl_t *opl);
 
 extern void	opl2_update2(opl_t *opl);
 extern void	opl3_update2(opl_t *opl);
@@ -1,6 +1,7 @@
 /* Copyright holders: Sarah Walker, SA1988
    see COPYING for more details
 */
+#include <stddef.h>
 #include "nukedopl.h"
 #include "sound.h"
 #include "snd_opl_backend.h"
@@ -13,6 +14,7 @@ static struct
 {
     struct opl3_chip opl3chip;
     int addr;
+    int newm;			/*CPU side copy of the OPL3 mode bit*/
     int timer[2];
     uint8_t timer_ctrl;
     uint8_t status_mask;
@@ -21,6 +23,7 @@ static struct
 
     void (*timer_callback)(void *param, int timer, uint64_t period);
     void *timer_param;
+    void (*reg_write)(void *param, int nr, uint16_t reg, uint8_t val);
 } opl[2];
 
 
@@ -47,7 +50,9 @@ opl_init(void (*timer_callback)(void *param, int timer, uint64_t period), void *
     opl[nr].timer_callback = timer_callback;
     opl[nr].timer_param = timer_param;
     opl[nr].is_opl3 = is_opl3;
+    opl[nr].reg_write = NULL;
 
+    opl[nr].newm = 0;
     opl[nr].opl3chip.newm = 0;
     OPL3_Reset(&opl[nr].opl3chip, 48000);
 }
@@ -82,13 +87,20 @@ void
 opl_write(int nr, uint16_t addr, uint8_t val)
 {
     if (!(addr & 1)) {
-	opl[nr].addr = (int)OPL3_WriteAddr(&opl[nr].opl3chip, addr, val) & 0x1ff;
+	/*Decoded here rather than with OPL3_WriteAddr(), as the chip
+	  itself may belong to a synthesis worker.*/
+	opl[nr].addr = val;
+	if ((addr & 2) && ((val == 0x05) || opl[nr].newm))
+		opl[nr].addr |= 0x100;
 	if (!opl[nr].is_opl3)
 		opl[nr].addr &= 0xff;
     } else {
-	OPL3_WriteRegBuffered(&opl[nr].opl3chip, (uint16_t) opl[nr].addr, val);
+	if (opl[nr].reg_write)
+		opl[nr].reg_write(opl[nr].timer_param, nr, (uint16_t) opl[nr].addr, val);
+	else
+		OPL3_WriteRegBuffered(&opl[nr].opl3chip, (uint16_t) opl[nr].addr, val);
 	if (opl[nr].addr == 0x105)
-		opl[nr].opl3chip.newm = opl[nr].addr & 0x01;
+		opl[nr].newm = val & 0x01;
 
 	switch (opl[nr].addr) {
 		case 0x02:	/*Timer 1*/
@@ -123,6 +135,23 @@ opl_write(int nr, uint16_t addr, uint8_t val)
 }
 
 
+/*Redirect chip register writes to reg_write, leaving only the timer and
+  status handling on the calling thread; the writes are then applied with
+  opl_write_reg() by whoever owns the synthesis.*/
+void
+opl_set_write_callback(int nr, void (*reg_write)(void *param, int nr, uint16_t reg, uint8_t val))
+{
+    opl[nr].reg_write = reg_write;
+}
+
+
+void
+opl_write_reg(int nr, uint16_t reg, uint8_t val)
+{
+    OPL3_WriteRegBuffered(&opl[nr].opl3chip, reg, val);
+}
+
+
 uint8_t
 opl_read(int nr, uint16_t addr)
 {
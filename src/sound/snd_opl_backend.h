@@ -7,6 +7,8 @@ extern "C" {
         void opl_init(void (*timer_callback)(void *param, int timer, uint64_t period), void *timer_param, int nr, int is_opl3);
         void opl_write(int nr, uint16_t addr, uint8_t val);
         uint8_t opl_read(int nr, uint16_t addr);
+        void opl_set_write_callback(int nr, void (*reg_write)(void *param, int nr, uint16_t reg, uint8_t val));
+        void opl_write_reg(int nr, uint16_t reg, uint8_t val);
         void opl_timer_over(int nr, int timer);
         void opl2_update(int nr, int32_t *buffer, int samples);
         void opl3_update(int nr, int32_t *buffer, int samples);
@@ -754,6 +754,7 @@ static void pas16_close(void *p)
 {
         pas16_t *pas16 = (pas16_t *)p;
         
+        opl_close(&pas16->opl);
         free(pas16);
 }
 
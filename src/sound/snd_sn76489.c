@@ -24,6 +24,11 @@ static float volslog[16]=
 
 void sn76489_update(sn76489_t *sn76489)
 {
+        /*With every channel at zero attenuation step the mix is always 0, but the
+          tone and noise generators still have to run so that the phase is right
+          when a channel is turned back up*/
+        int silent = !sn76489->vol[0] && !sn76489->vol[1] && !sn76489->vol[2] && !sn76489->vol[3];
+
         for (; sn76489->pos < sound_pos_global; sn76489->pos++)
         {
                 int c;
@@ -31,8 +36,11 @@ void sn76489_update(sn76489_t *sn76489)
                         
                 for (c = 1; c < 4; c++)
                 {
-                        if (sn76489->latch[c] > 256) result += (int16_t) (volslog[sn76489->vol[c]] * sn76489->stat[c]);
-                        else                         result += (int16_t) (volslog[sn76489->vol[c]] * 127);
+                        if (!silent)
+                        {
+                                if (sn76489->latch[c] > 256) result += (int16_t) (volslog[sn76489->vol[c]] * sn76489->stat[c]);
+                                else                         result += (int16_t) (volslog[sn76489->vol[c]] * 127);
+                        }
 
                         sn76489->count[c] -= (256 * sn76489->psgconst);
                         while ((int)sn76489->count[c] < 0)
@@ -41,7 +49,8 @@ void sn76489_update(sn76489_t *sn76489)
                                 sn76489->stat[c] = -sn76489->stat[c];
                         }
                 }
-                result += (((sn76489->shift & 1) ^ 1) * 127 * volslog[sn76489->vol[0]] * 2);
+                if (!silent)
+                        result += (((sn76489->shift & 1) ^ 1) * 127 * volslog[sn76489->vol[0]] * 2);
 
                 sn76489->count[0] -= (512 * sn76489->psgconst);
                 while ((int)sn76489->count[0] < 0 && sn76489->latch[0])
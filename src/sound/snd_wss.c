@@ -188,6 +188,7 @@ void wss_close(void *p)
 {
         wss_t *wss = (wss_t *)p;
         
+        opl_close(&wss->opl);
         free(wss);
 }
 
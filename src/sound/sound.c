@@ -31,6 +31,7 @@
 #include "../plat.h"
 #include "sound.h"
 #include "midi.h"
+#include "snd_capture.h"
 #include "snd_opl.h"
 #include "snd_cms.h"
 #include "snd_adlib.h"
@@ -59,10 +60,46 @@ typedef struct {
         void *priv;
 } sound_handler_t;
 
+/*Register write queued for a synthesis worker, with the sample position
+  within the current buffer at which it was made*/
+typedef struct {
+        uint16_t pos, addr;
+        uint8_t val;
+} sound_worker_event_t;
+
+#define SOUND_WORKER_QUEUE_SIZE	8192
+#define SOUND_WORKER_QUEUE_MASK	(SOUND_WORKER_QUEUE_SIZE - 1)
+
+struct sound_worker_t {
+        void (*render)(void *priv, int32_t *buffer, int start, int end);
+        void (*write)(void *priv, uint16_t addr, uint8_t val);
+        void *priv;
+
+        thread_t *thread_h;
+        event_t *start_event, *done_event;
+        volatile int running;
+        int busy;
+
+        sound_worker_event_t queue[SOUND_WORKER_QUEUE_SIZE];
+        volatile uint32_t wp, rp;
+
+        /*Buffer being filled for the current period on the CPU thread*/
+        int cur, pos;
+        /*Previous period, handed to the worker at the buffer boundary*/
+        int work_buf, work_pos;
+        uint32_t work_wp;
+
+        int32_t buffer[2][SOUNDBUFLEN * 2];
+};
+
 
 int sound_card_current = 0;
 int sound_pos_global = 0;
 int sound_gain = 0;
+int sound_worker_enable = 0;
+int sound_backend_current = 0;
+int sound_queue_depth = 4;
+int sound_block_mult = 1;
 
 
 static sound_handler_t sound_handlers[8];
@@ -71,6 +108,7 @@ static thread_t *sound_cd_thread_h;
 static event_t *sound_cd_event;
 static event_t *sound_cd_start_event;
 static int32_t *outbuffer;
+static int32_t source_buffer[SOUNDBUFLEN * 2];
 static float *outbuffer_ex;
 static int16_t *outbuffer_ex_int16;
 static int sound_handlers_num;
@@ -112,6 +150,35 @@ static const SOUND_CARD sound_cards[] =
 };
 
 
+static void	null_init(void);
+static void	null_close(void);
+static void	null_set_midi(int freq, int buf_size);
+static void	null_submit(int stream, void *buf, int size, int freq);
+static int	null_queued(int stream);
+static void	file_init(void);
+static void	file_close(void);
+
+static const sound_backend_t null_backend = {
+    "null",
+    null_init, null_close, null_set_midi, null_submit, null_queued
+};
+
+/*Writes all streams to WAV files through the capture module.*/
+static const sound_backend_t file_backend = {
+    "file",
+    file_init, file_close, null_set_midi, null_submit, null_queued
+};
+
+static int sound_midi_freq = 44100;
+
+static const sound_backend_t *sound_backends[] = {
+    &openal_backend,
+    &null_backend,
+    &file_backend,
+    NULL
+};
+
+
 #ifdef ENABLE_SOUND_LOG
 int sound_do_log = ENABLE_SOUND_LOG;
 
@@ -213,12 +280,59 @@ sound_cd_clean_buffers(void)
 }
 
 
+/*Mix one drive's CD audio into the output buffer. Per-port channel select
+  and volume are turned into masks and gains up front, so the sample loops
+  have no branches beyond saturation and can be vectorized.*/
+static void
+sound_cd_mix(int16_t *in, int *channel_select, float audio_vol_l, float audio_vol_r)
+{
+    /*A port that is muted or has no channel routed to it stays at 0.*/
+    const float gain_l = ((audio_vol_l != 0.0) && (channel_select[0] != 0)) ? audio_vol_l : 0.0;
+    const float gain_r = ((audio_vol_r != 0.0) && (channel_select[1] != 0)) ? audio_vol_r : 0.0;
+    const int16_t mask_l0 = (channel_select[0] & 1) ? 0xffff : 0;	/* Channel 0 => Port 0 */
+    const int16_t mask_l1 = (channel_select[0] & 2) ? 0xffff : 0;	/* Channel 1 => Port 0 */
+    const int16_t mask_r0 = (channel_select[1] & 1) ? 0xffff : 0;	/* Channel 0 => Port 1 */
+    const int16_t mask_r1 = (channel_select[1] & 2) ? 0xffff : 0;	/* Channel 1 => Port 1 */
+    /*Sound card CD volume*/
+    const double vol_l = ((float) cd_vol_l) / 65535.0;
+    const double vol_r = ((float) cd_vol_r) / 65535.0;
+    float l, r;
+    int c;
+
+    if (sound_is_float) {
+	for (c = 0; c < CD_BUFLEN*2; c += 2) {
+		l = (((float) (in[c] & mask_l0)) + ((float) (in[c + 1] & mask_l1))) * gain_l;
+		r = (((float) (in[c] & mask_r0)) + ((float) (in[c + 1] & mask_r1))) * gain_r;
+		l *= vol_l;
+		r *= vol_r;
+
+		cd_out_buffer[c] += (l / 32768.0);
+		cd_out_buffer[c+1] += (r / 32768.0);
+	}
+    } else {
+	for (c = 0; c < CD_BUFLEN*2; c += 2) {
+		l = (((float) (in[c] & mask_l0)) + ((float) (in[c + 1] & mask_l1))) * gain_l;
+		r = (((float) (in[c] & mask_r0)) + ((float) (in[c + 1] & mask_r1))) * gain_r;
+		l *= vol_l;
+		r *= vol_r;
+
+		l = (l > 32767) ? 32767 : l;
+		l = (l < -32768) ? -32768 : l;
+		r = (r > 32767) ? 32767 : r;
+		r = (r < -32768) ? -32768 : r;
+
+		cd_out_buffer_int16[c] += l;
+		cd_out_buffer_int16[c+1] += r;
+	}
+    }
+}
+
+
 static void
 sound_cd_thread(void *param)
 {
-    int c, r, i, channel_select[2];
+    int r, i, channel_select[2];
     float audio_vol_l, audio_vol_r;
-    float cd_buffer_temp[2] = {0.0, 0.0};
 
     thread_set_event(sound_cd_start_event);
 
@@ -258,60 +372,7 @@ sound_cd_thread(void *param)
 			channel_select[1] = 2;
 		}
 
-		for (c = 0; c < CD_BUFLEN*2; c += 2) {
-			/*Apply ATAPI channel select*/
-			cd_buffer_temp[0] = cd_buffer_temp[1] = 0.0;
-
-#if 0
-			if (channel_select[0] & 1)
-				cd_buffer_temp[0] += ((float) cd_buffer[i][c]) * audio_vol_l;
-			if (channel_select[0] & 2)
-				cd_buffer_temp[1] += ((float) cd_buffer[i][c]) * audio_vol_l;
-			if (channel_select[1] & 1)
-				cd_buffer_temp[0] += ((float) cd_buffer[i][c + 1]) * audio_vol_r;
-			if (channel_select[1] & 2)
-				cd_buffer_temp[1] += ((float) cd_buffer[i][c + 1]) * audio_vol_r;
-#else
-			if ((audio_vol_l != 0.0) && (channel_select[0] != 0)) {
-				if (channel_select[0] & 1)
-					cd_buffer_temp[0] += ((float) cd_buffer[i][c]);		/* Channel 0 => Port 0 */
-				if (channel_select[0] & 2)
-					cd_buffer_temp[0] += ((float) cd_buffer[i][c + 1]);	/* Channel 1 => Port 0 */
-
-				cd_buffer_temp[0] *= audio_vol_l;				/* Multiply Port 0 by Port 0 volume */
-			}
-
-			if ((audio_vol_r != 0.0) && (channel_select[1] != 0)) {
-				if (channel_select[1] & 1)
-					cd_buffer_temp[1] += ((float) cd_buffer[i][c]);		/* Channel 0 => Port 1 */
-				if (channel_select[1] & 2)
-					cd_buffer_temp[1] += ((float) cd_buffer[i][c + 1]);	/* Channel 1 => Port 1 */
-
-				cd_buffer_temp[1] *= audio_vol_r;				/* Multiply Port 1 by Port 1 volume */
-			}
-#endif
-
-			/*Apply sound card CD volume*/
-			cd_buffer_temp[0] *= ((float) cd_vol_l) / 65535.0;
-			cd_buffer_temp[1] *= ((float) cd_vol_r) / 65535.0;
-
-			if (sound_is_float) {
-				cd_out_buffer[c] += (cd_buffer_temp[0] / 32768.0);
-				cd_out_buffer[c+1] += (cd_buffer_temp[1] / 32768.0);
-			} else {
-				if (cd_buffer_temp[0] > 32767)
-					cd_buffer_temp[0] = 32767;
-				if (cd_buffer_temp[0] < -32768)
-					cd_buffer_temp[0] = -32768;
-				if (cd_buffer_temp[1] > 32767)
-					cd_buffer_temp[1] = 32767;
-				if (cd_buffer_temp[1] < -32768)
-					cd_buffer_temp[1] = -32768;
-
-				cd_out_buffer_int16[c] += cd_buffer_temp[0];
-				cd_out_buffer_int16[c+1] += cd_buffer_temp[1];
-			}
-		}
+		sound_cd_mix(cd_buffer[i], channel_select, audio_vol_l, audio_vol_r);
 	}
 
 	if (sound_is_float)
@@ -382,6 +443,328 @@ sound_add_handler(void (*get_buffer)(int32_t *buffer, int len, void *p), void *p
 }
 
 
+/*Apply queued register writes up to queue position end_wp, rendering the
+  intervals between them into buffer, then render up to end. Returns the
+  new render position.*/
+static int
+sound_worker_process(sound_worker_t *w, int32_t *buffer, int pos, int end, uint32_t end_wp)
+{
+    sound_worker_event_t *ev;
+
+    while (w->rp != end_wp) {
+	ev = &w->queue[w->rp];
+	if ((ev->pos > pos) && (ev->pos <= end)) {
+		w->render(w->priv, buffer, pos, ev->pos);
+		pos = ev->pos;
+	}
+	w->write(w->priv, ev->addr, ev->val);
+	w->rp = (w->rp + 1) & SOUND_WORKER_QUEUE_MASK;
+    }
+
+    if (end > pos) {
+	w->render(w->priv, buffer, pos, end);
+	pos = end;
+    }
+
+    return pos;
+}
+
+
+static void
+sound_worker_thread(void *param)
+{
+    sound_worker_t *w = (sound_worker_t *)param;
+
+    while (1) {
+	thread_wait_event(w->start_event, -1);
+	thread_reset_event(w->start_event);
+
+	if (!w->running)
+		break;
+
+	sound_worker_process(w, w->buffer[w->work_buf], w->work_pos, SOUNDBUFLEN, w->work_wp);
+
+	thread_set_event(w->done_event);
+    }
+}
+
+
+/*Wait for the worker to finish the period it was handed, if any.*/
+static void
+sound_worker_join(sound_worker_t *w)
+{
+    if (w->busy) {
+	thread_wait_event(w->done_event, -1);
+	thread_reset_event(w->done_event);
+	w->busy = 0;
+    }
+}
+
+
+sound_worker_t *
+sound_worker_create(void (*render)(void *priv, int32_t *buffer, int start, int end),
+		    void (*write)(void *priv, uint16_t addr, uint8_t val), void *priv)
+{
+    sound_worker_t *w = (sound_worker_t *)malloc(sizeof(sound_worker_t));
+
+    memset(w, 0, sizeof(sound_worker_t));
+    w->render = render;
+    w->write = write;
+    w->priv = priv;
+    w->running = 1;
+
+    w->start_event = thread_create_event();
+    w->done_event = thread_create_event();
+    w->thread_h = thread_create(sound_worker_thread, w);
+
+    return w;
+}
+
+
+void
+sound_worker_close(sound_worker_t *w)
+{
+    if (w == NULL)
+	return;
+
+    sound_worker_join(w);
+
+    w->running = 0;
+    thread_set_event(w->start_event);
+    thread_wait(w->thread_h, -1);
+
+    thread_destroy_event(w->start_event);
+    thread_destroy_event(w->done_event);
+
+    free(w);
+}
+
+
+/*Bring the synthesis state up to sound_pos_global on the calling thread;
+  used before register reads that depend on it, and when the queue fills.*/
+void
+sound_worker_sync(sound_worker_t *w)
+{
+    sound_worker_join(w);
+
+    w->pos = sound_worker_process(w, w->buffer[w->cur], w->pos, sound_pos_global, w->wp);
+}
+
+
+void
+sound_worker_write(sound_worker_t *w, uint16_t addr, uint8_t val)
+{
+    sound_worker_event_t *ev;
+
+    if (((w->wp + 1) & SOUND_WORKER_QUEUE_MASK) == w->rp)
+	sound_worker_sync(w);
+
+    ev = &w->queue[w->wp];
+    ev->pos = sound_pos_global;
+    ev->addr = addr;
+    ev->val = val;
+    w->wp = (w->wp + 1) & SOUND_WORKER_QUEUE_MASK;
+}
+
+
+/*Called once per buffer from the device's get_buffer handler. Collects the
+  period the worker finished rendering, then hands it the period that has
+  just ended, so output is delayed by one buffer.*/
+void
+sound_worker_get_buffer(sound_worker_t *w, int32_t *buffer)
+{
+    sound_worker_join(w);
+
+    memcpy(buffer, w->buffer[w->cur ^ 1], SOUNDBUFLEN * 2 * sizeof(int32_t));
+
+    w->work_buf = w->cur;
+    w->work_pos = w->pos;
+    w->work_wp = w->wp;
+    w->cur ^= 1;
+    w->pos = 0;
+
+    w->busy = 1;
+    thread_set_event(w->start_event);
+}
+
+
+static void
+null_init(void)
+{
+}
+
+
+static void
+null_close(void)
+{
+}
+
+
+static void
+null_set_midi(int freq, int buf_size)
+{
+}
+
+
+static void
+null_submit(int stream, void *buf, int size, int freq)
+{
+}
+
+
+static int
+null_queued(int stream)
+{
+    return -1;
+}
+
+
+static void
+file_init(void)
+{
+    if (sound_capture_path[0] == L'\0')
+	plat_append_filename(sound_capture_path, usr_path, L"audio.wav");
+
+    sound_capture_start();
+}
+
+
+/*The capture runs from pc_init() to pc_close(), across hard resets;
+  closing the backend only brings the WAV headers up to date.*/
+static void
+file_close(void)
+{
+    sound_capture_sync();
+}
+
+
+char *
+sound_backend_get_internal_name(int backend)
+{
+    return (char *) sound_backends[backend]->internal_name;
+}
+
+
+int
+sound_backend_get_from_internal_name(char *s)
+{
+    int c = 0;
+
+    while (sound_backends[c] != NULL) {
+	if (!strcmp(sound_backends[c]->internal_name, s))
+		return(c);
+	c++;
+    }
+
+    return(0);
+}
+
+
+void
+sound_backend_init(void)
+{
+    sound_backends[sound_backend_current]->init();
+}
+
+
+void
+sound_backend_close(void)
+{
+    sound_backends[sound_backend_current]->close();
+}
+
+
+int
+sound_backend_queued(int stream)
+{
+    return sound_backends[sound_backend_current]->queued(stream);
+}
+
+
+void
+al_set_midi(int freq, int buf_size)
+{
+    sound_midi_freq = freq;
+
+    sound_backends[sound_backend_current]->set_midi(freq, buf_size);
+}
+
+
+static void
+sound_submit(int stream, void *buf, int size, int freq)
+{
+    sound_capture_write(stream, buf, size, freq);
+
+    sound_backends[sound_backend_current]->submit(stream, buf, size, freq);
+}
+
+
+void
+givealbuffer(void *buf)
+{
+    sound_submit(SOUND_STREAM_MAIN, buf, SOUNDBUFLEN << 1, 48000);
+}
+
+
+void
+givealbuffer_cd(void *buf)
+{
+    sound_submit(SOUND_STREAM_CD, buf, CD_BUFLEN << 1, CD_FREQ);
+}
+
+
+void
+givealbuffer_midi(void *buf, uint32_t size)
+{
+    sound_submit(SOUND_STREAM_MIDI, buf, size, sound_midi_freq);
+}
+
+
+/*Final conversion of the mixed buffer to the output format. Kept as plain
+  branch-free loops so the compiler can vectorize them.*/
+static void
+sound_convert_float(float *out, const int32_t *in, int len)
+{
+    int c;
+
+    for (c = 0; c < len; c++)
+	out[c] = ((float) in[c]) / 32768.0;
+}
+
+
+static void
+sound_convert_int16(int16_t *out, const int32_t *in, int len)
+{
+    int32_t v;
+    int c;
+
+    for (c = 0; c < len; c++) {
+	v = in[c];
+	v = (v > 32767) ? 32767 : v;
+	v = (v < -32768) ? -32768 : v;
+	out[c] = v;
+    }
+}
+
+
+/*Return the value sound_pos_global had at timestamp ts (in the 32:32 timer
+  format), for devices that render lazily and catch up after the fact. Only
+  valid for times since the last buffer was handed out.*/
+int
+sound_pos_at(uint64_t ts)
+{
+    int64_t remaining = (int64_t) (sound_poll_timer.ts.ts64 - ts);
+    int pos;
+
+    if (remaining <= 0)
+	return sound_pos_global;
+
+    pos = sound_pos_global - (int) ((uint64_t) (remaining - 1) / sound_poll_latch);
+
+    return (pos < 0) ? 0 : pos;
+}
+
+
 void
 sound_poll(void *priv)
 {
@@ -391,30 +774,39 @@ sound_poll(void *priv)
 
     sound_pos_global++;
     if (sound_pos_global == SOUNDBUFLEN) {
-	int c;
+	int c, i;
 
 	memset(outbuffer, 0, SOUNDBUFLEN * 2 * sizeof(int32_t));
 
-	for (c = 0; c < sound_handlers_num; c++)
-		sound_handlers[c].get_buffer(outbuffer, SOUNDBUFLEN, sound_handlers[c].priv);
-
-	for (c = 0; c < SOUNDBUFLEN * 2; c++) {
-		if (sound_is_float)
-			outbuffer_ex[c] = ((float) outbuffer[c]) / 32768.0;
-		else {
-			if (outbuffer[c] > 32767)
-				outbuffer[c] = 32767;
-			if (outbuffer[c] < -32768)
-				outbuffer[c] = -32768;
+	if (sound_capture_active && sound_capture_sources) {
+		/* Render each handler on its own so it can be captured
+		   separately, then add it to the mix. */
+		for (c = 0; c < sound_handlers_num; c++) {
+			memset(source_buffer, 0, SOUNDBUFLEN * 2 * sizeof(int32_t));
+			sound_handlers[c].get_buffer(source_buffer, SOUNDBUFLEN, sound_handlers[c].priv);
+			for (i = 0; i < SOUNDBUFLEN * 2; i++)
+				outbuffer[i] += source_buffer[i];
 
-			outbuffer_ex_int16[c] = outbuffer[c];
+			if (sound_is_float) {
+				sound_convert_float(outbuffer_ex, source_buffer, SOUNDBUFLEN * 2);
+				sound_capture_write(CAPTURE_SOURCE + c, outbuffer_ex, SOUNDBUFLEN * 2, 48000);
+			} else {
+				sound_convert_int16(outbuffer_ex_int16, source_buffer, SOUNDBUFLEN * 2);
+				sound_capture_write(CAPTURE_SOURCE + c, outbuffer_ex_int16, SOUNDBUFLEN * 2, 48000);
+			}
 		}
+	} else {
+		for (c = 0; c < sound_handlers_num; c++)
+			sound_handlers[c].get_buffer(outbuffer, SOUNDBUFLEN, sound_handlers[c].priv);
 	}
 
-	if (sound_is_float)
+	if (sound_is_float) {
+		sound_convert_float(outbuffer_ex, outbuffer, SOUNDBUFLEN * 2);
 		givealbuffer(outbuffer_ex);
-	else
+	} else {
+		sound_convert_int16(outbuffer_ex_int16, outbuffer, SOUNDBUFLEN * 2);
 		givealbuffer(outbuffer_ex_int16);
+	}
 
 	if (cd_thread_enable) {
                 cd_buf_update--;
@@ -442,7 +834,7 @@ sound_reset(void)
     sound_realloc_buffers();
 
     midi_device_init();
-    inital();
+    sound_backend_init();
 
     timer_add(&sound_poll_timer, sound_poll, NULL, 1);
 
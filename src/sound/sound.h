@@ -35,8 +35,25 @@ extern int	gated,
 
 extern int	sound_pos_global;
 extern int	sound_card_current;
+extern int	sound_worker_enable;
 
 
+/*Synthesis worker: renders a sound chip on its own thread, fed with
+  timestamped register writes, one buffer behind the CPU thread.*/
+typedef struct sound_worker_t sound_worker_t;
+
+extern sound_worker_t	*sound_worker_create(void (*render)(void *priv, int32_t *buffer, \
+					     int start, int end), \
+					     void (*write)(void *priv, uint16_t addr, \
+					     uint8_t val), void *priv);
+extern void	sound_worker_close(sound_worker_t *w);
+extern void	sound_worker_sync(sound_worker_t *w);
+extern void	sound_worker_write(sound_worker_t *w, uint16_t addr, uint8_t val);
+extern void	sound_worker_get_buffer(sound_worker_t *w, int32_t *buffer);
+
+
+extern int	sound_pos_at(uint64_t ts);
+
 extern void	sound_add_handler(void (*get_buffer)(int32_t *buffer, \
 				  int len, void *p), void *p);
 
@@ -61,10 +78,42 @@ extern void	sound_card_reset(void);
 extern void	sound_cd_thread_end(void);
 extern void	sound_cd_thread_reset(void);
 
-extern void	closeal(void);
-extern void	inital(void);
+
+/*Audio output backend. Each one receives the main mix, CD audio and MIDI as
+  separate streams of interleaved stereo, in the sound_is_float format.*/
+#define SOUND_STREAM_MAIN	0
+#define SOUND_STREAM_CD		1
+#define SOUND_STREAM_MIDI	2
+
+#define SOUND_QUEUE_MAX		16
+#define SOUND_BLOCK_MAX		8
+
+typedef struct {
+    const char	*internal_name;
+
+    void	(*init)(void);
+    void	(*close)(void);
+    void	(*set_midi)(int freq, int buf_size);
+    void	(*submit)(int stream, void *buf, int size, int freq);
+    int		(*queued)(int stream);		/* buffers not yet played, -1 if unknown */
+} sound_backend_t;
+
+extern int	sound_backend_current;
+extern int	sound_queue_depth;		/* buffers queued per stream */
+extern int	sound_block_mult;		/* SOUNDBUFLEN periods per block */
+
+extern const sound_backend_t	openal_backend;
+
+extern char	*sound_backend_get_internal_name(int backend);
+extern int	sound_backend_get_from_internal_name(char *s);
+extern void	sound_backend_init(void);
+extern void	sound_backend_close(void);
+extern int	sound_backend_queued(int stream);
+
 extern void	givealbuffer(void *buf);
 extern void	givealbuffer_cd(void *buf);
+extern void	givealbuffer_midi(void *buf, uint32_t size);
+extern void	al_set_midi(int freq, int buf_size);
 
 
 #endif	/*EMU_SOUND_H*/
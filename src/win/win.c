@@ -376,7 +376,7 @@ WinMain(HINSTANCE hInst, HINSTANCE hPrev, LPSTR lpszArg, int nCmdShow)
 	if (source_hwnd)
 		PostMessage((HWND) (uintptr_t) source_hwnd, WM_HAS_SHUTDOWN, (WPARAM) 0, (LPARAM) hwndMain);
 
-	return(1);
+	return(exit_status);
     }
 
     /* Cleanup: we may no longer need the console. */
@@ -654,6 +654,76 @@ plat_delay_ms(uint32_t count)
 }
 
 
+/* Identify a file by where it lives and when it was last changed, so
+   that all processes opening the same unchanged file agree on it. */
+int
+plat_file_id(const wchar_t *path, uint64_t *id)
+{
+    BY_HANDLE_FILE_INFORMATION bhfi;
+    uint32_t v[7];
+    uint8_t *p = (uint8_t *) v;
+    HANDLE h;
+    int i, ret;
+
+    h = CreateFile(path, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		   NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE)
+	return(0);
+
+    ret = GetFileInformationByHandle(h, &bhfi);
+    CloseHandle(h);
+    if (! ret)
+	return(0);
+
+    v[0] = bhfi.dwVolumeSerialNumber;
+    v[1] = bhfi.nFileIndexHigh;
+    v[2] = bhfi.nFileIndexLow;
+    v[3] = bhfi.nFileSizeHigh;
+    v[4] = bhfi.nFileSizeLow;
+    v[5] = bhfi.ftLastWriteTime.dwHighDateTime;
+    v[6] = bhfi.ftLastWriteTime.dwLowDateTime;
+
+    /* FNV-1a. */
+    *id = 0xcbf29ce484222325ULL;
+    for (i = 0; i < sizeof(v); i++) {
+	*id ^= p[i];
+	*id *= 0x100000001b3ULL;
+    }
+
+    return(1);
+}
+
+
+/* Map a named block of shared memory, creating it (zeroed) if no other
+   process has it mapped yet. */
+void *
+plat_shm_open(const wchar_t *name, uint64_t size)
+{
+    HANDLE h;
+    void *p;
+
+    h = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+			  (DWORD) (size >> 32), (DWORD) size, name);
+    if (h == NULL)
+	return(NULL);
+
+    p = MapViewOfFile(h, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T) size);
+
+    /* The view keeps the mapping alive. */
+    CloseHandle(h);
+
+    return(p);
+}
+
+
+void
+plat_shm_close(void *p)
+{
+    if (p != NULL)
+	UnmapViewOfFile(p);
+}
+
+
 /* Return the VIDAPI number for the given name. */
 int
 plat_vidapi(char *name)
@@ -18,6 +18,7 @@
 #define BITMAP WINDOWS_BITMAP
 #include <windows.h>
 #include <windowsx.h>
+#include <winioctl.h>
 #undef BITMAP
 #include <commctrl.h>
 #include <stdio.h>
@@ -25,6 +26,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <wchar.h>
+#include <io.h>
 #include "../86box.h"
 #include "../plat.h"
 #include "../random.h"
@@ -34,6 +36,9 @@
 #include "win.h"
 
 
+#define ZIP_FORMAT_SIZE	0x40000		/* holds the MBR, boot sector and FATs of a new ZIP image */
+
+
 typedef struct {
 	int hole;
 	int sides;
@@ -294,32 +299,29 @@ create_zip_sector_image(WCHAR *file_name, disk_size_t disk_size, uint8_t is_zdi,
     uint32_t total_size = 0;
     uint32_t total_sectors = 0;
     uint32_t sector_bytes = 0;
-    uint32_t root_dir_bytes = 0;
-    uint32_t fat_size = 0;
-    uint32_t fat1_offs = 0;
-    uint32_t fat2_offs = 0;
-    uint32_t zero_bytes = 0;
     uint16_t base = 0x1000;
     uint32_t pbar_max = 0;
     uint32_t i;
+    DWORD bytes;
     MSG msg;
     
     f = plat_fopen(file_name, L"wb");
     if (!f)
 	return 0;
 
+    /* Only the formatted area at the start is written; marking the file
+       sparse keeps Windows from zero-filling the rest when the file is
+       extended to its full size at the end. */
+    DeviceIoControl((HANDLE) _get_osfhandle(_fileno(f)), FSCTL_SET_SPARSE,
+		    NULL, 0, NULL, 0, &bytes, NULL);
+
     sector_bytes = (128 << disk_size.sector_len);
     total_sectors = disk_size.sides * disk_size.tracks * disk_size.sectors;
     if (total_sectors > ZIP_SECTORS)
 	total_sectors = ZIP_250_SECTORS;
     total_size = total_sectors * sector_bytes;
-    root_dir_bytes = (disk_size.root_dir_entries << 5);
-    fat_size = (disk_size.spfat * sector_bytes);
-    fat1_offs = sector_bytes;
-    fat2_offs = fat1_offs + fat_size;
-    zero_bytes = fat2_offs + fat_size + root_dir_bytes;
 
-    pbar_max = total_size;
+    pbar_max = ZIP_FORMAT_SIZE;
     if (is_zdi)
 	pbar_max += base;
     pbar_max >>= 11;
@@ -364,8 +366,8 @@ create_zip_sector_image(WCHAR *file_name, disk_size_t disk_size, uint8_t is_zdi,
 	pbar_max -= 2;
     }
 
-    empty = (unsigned char *) malloc(total_size);
-    memset(empty, 0x00, zero_bytes);
+    empty = (unsigned char *) malloc(ZIP_FORMAT_SIZE);
+    memset(empty, 0x00, ZIP_FORMAT_SIZE);
 
     if (total_sectors == ZIP_SECTORS) {
 	/* ZIP 100 */
@@ -506,6 +508,9 @@ create_zip_sector_image(WCHAR *file_name, disk_size_t disk_size, uint8_t is_zdi,
 
     free(empty);
 
+    fseek(f, (is_zdi ? base : 0) + total_size - 1, SEEK_SET);
+    fputc(0x00, f);
+
     fclose(f);
 
     return 1;
@@ -2634,6 +2634,19 @@ win_settings_hard_disks_add_proc(HWND hdlg, UINT message, WPARAM wParam, LPARAM
 						return TRUE;							
 					}
 
+					if (image_is_hdz(hd_file_name, 0)) {
+						/* Compressed image, all blocks start out empty. */
+						fclose(f);
+						if (!hdz_create(hd_file_name, size >> 9, spt, hpc, tracks)) {
+							settings_msgbox(MBX_ERROR, (wchar_t *)IDS_4108);
+							return TRUE;
+						}
+						settings_msgbox(MBX_INFO, (wchar_t *)IDS_4113);
+						hard_disk_added = 1;
+						EndDialog(hdlg, 0);
+						return TRUE;
+					}
+
 					if (image_is_hdi(hd_file_name)) {
 						if (size >= 0x100000000ll) {
 							fclose(f);
@@ -2773,7 +2786,8 @@ hdd_add_file_open_error:
 						return TRUE;
 					}
 					if (existing & 1) {
-						if (image_is_hdi(wopenfilestring) || image_is_hdx(wopenfilestring, 1)) {
+						if (image_is_hdi(wopenfilestring) || image_is_hdx(wopenfilestring, 1) ||
+						    image_is_hdz(wopenfilestring, 1)) {
 							fseeko64(f, 0x10, SEEK_SET);
 							fread(&sector_size, 1, 4, f);
 							if (sector_size != 512) {
@@ -37,6 +37,7 @@
 #include "../video/vid_ega.h"		// for update_overscan
 #include "../plat.h"
 #include "../plat_midi.h"
+#include "../disk/disk_trace.h"
 #include "../ui.h"
 #include "win.h"
 #ifdef USE_DISCORD
@@ -302,6 +303,7 @@ MainWindowProcedure(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
     RECT rect;
 
     int temp_x, temp_y;
+    wchar_t temp_path[1024];
 
     switch (message) {
 	case WM_CREATE:
@@ -365,6 +367,15 @@ MainWindowProcedure(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 				AboutDialogCreate(hwnd);
 				break;
 
+			case IDM_SAVE_IO_STATS:
+				if (disk_trace_path[0] != L'\0')
+					disk_trace_save(disk_trace_path);
+				else {
+					plat_append_filename(temp_path, usr_path, L"disk_io.json");
+					disk_trace_save(temp_path);
+				}
+				break;
+
 			case IDM_UPDATE_ICONS:
 				update_icons ^= 1;
 				CheckMenuItem(hmenu, IDM_UPDATE_ICONS, update_icons ? MF_CHECKED : MF_UNCHECKED);